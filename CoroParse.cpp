@@ -38,15 +38,7 @@ namespace ex
 
 	template < class Rule > struct Action : nothing< Rule > { };
 
-	template < > struct Action< Error >
-	{
-		template < class ActionInput, class Coro >
-		static void apply(const ActionInput& in, Coro& coro)
-		{
-			// std::cout << in.string() << std::endl;
-			coro.push_token(in.string());
-		}
-	};
+	template < > struct Action< Error > : PushToken { };
 	// template < > struct Action< string<'e', 'r', 'r', 'o', 'r'> >
 	// {
 	// 	template < class ActionInput >
@@ -67,11 +59,14 @@ int main()
 	// p.push_token("G. Mahler!");
 	// std::cout << p.result() << std::endl;
 
+	// Frames of `ffa` and its nested calls are carved out of `arena` instead of the global heap.
+	FrameArena arena;
+	FrameArena::Scope arena_scope { &arena };
+
 	auto f = ffa(2);
 	// f.__dbg_print_coro_stack();
 	f.push_value("Js Bach");
 	f.push_value("Mahler");
-	f.result();
 	std::cout << f.result() << std::endl;
 
 	string_input in("error['low pressure',error['next err']]", "");
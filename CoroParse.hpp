@@ -2,14 +2,228 @@
 
 #include <string_view>
 #include <coroutine>
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <variant>
 #include <tao/pegtl.hpp>
 
 namespace coroparse
 {
 	struct NextTokenT { };
-	inline extern NextTokenT NextToken = NextTokenT{ };
+	inline NextTokenT NextToken = NextTokenT{ };
 	struct EndTokenT { };
-	inline extern EndTokenT EndToken = EndTokenT{ };
+	inline EndTokenT EndToken = EndTokenT{ };
+	// `co_await NextTokens{ n }` takes up to `n` tokens at once as a `std::span< T >` (Degenerator only).
+	// The span is empty at end of input.
+	struct NextTokens { std::size_t count = 1; };
+	// `co_await NextTokenWith{ f }` is `f(co_await NextToken)`: the next token (nullptr at end of
+	// input) goes through `f`, for helpers that check or convert it (Degenerator only).
+	template < class F >
+	struct NextTokenWith { F f; };
+	// Aggregate CTAD would deduce `F` too, but Clang only has it from version 17.
+	template < class F >
+	NextTokenWith(F) -> NextTokenWith< F >;
+
+	// `co_return ParseError{ "..." }` rejects the input without throwing. The error skips every
+	// frame between the failing one and the base, which finishes with it; see `try_result()`.
+	// `message` is not copied, it must outlive the parser (e.g. a string literal).
+	struct ParseError
+	{
+		std::string_view message;
+	};
+
+	// Either the value a parser returned or the ParseError it was rejected with.
+	template < class R >
+	class Expected
+	{
+	public:
+		Expected(R value) : storage { std::in_place_index< 0 >, std::move(value) } { }
+		Expected(ParseError error) : storage { std::in_place_index< 1 >, error } { }
+
+		bool has_value() const { return storage.index() == 0; }
+		explicit operator bool() const { return has_value(); }
+
+		R& value() { assert(has_value()); return *std::get_if< 0 >(&storage); }
+		R& operator*() { return value(); }
+		R* operator->() { return std::addressof(value()); }
+		const R& value() const { assert(has_value()); return *std::get_if< 0 >(&storage); }
+		const R& operator*() const { return value(); }
+		const R* operator->() const { return std::addressof(value()); }
+		const ParseError& error() const { assert(!has_value()); return *std::get_if< 1 >(&storage); }
+
+	private:
+		std::variant< R, ParseError > storage;
+	};
+
+	// `result()` on a rejected parse: throws when exceptions are available, aborts otherwise.
+	[[noreturn]] inline void fail_result(const ParseError& error)
+	{
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+		throw std::runtime_error(std::string(error.message));
+#else
+		std::fprintf(stderr, "coroparse: result() of a rejected parse: %.*s\n", static_cast< int >(error.message.size()), error.message.data());
+		std::abort();
+#endif
+	}
+
+	// Stack allocator for coroutine frames. Nested parser frames are created and destroyed
+	// strictly LIFO along the `prev` chain, so a frame is a pointer bump and freeing the
+	// top frame is a pointer decrement. Chunks are kept after being emptied,
+	// so a parse that is re-run reaches zero allocations once the deepest nesting has been seen.
+	// Out-of-order frees (e.g. two top-level parsers destroyed in creation order) are tolerated:
+	// the block is marked dead and reclaimed once everything above it is gone.
+	class FrameArena
+	{
+	public:
+		static constexpr std::size_t alignment = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+		explicit FrameArena(std::size_t chunk_size_ = 64 * 1024) : chunk_size { chunk_size_ } { }
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+		~FrameArena()
+		{
+			assert((!top || (!top->last && !top->prev)) && "Frames are still alive in this arena.");
+			while (head) ::operator delete(std::exchange(head, head->next));
+		}
+
+		// Frames of coroutines created while a scope is alive (on this thread) come from `arena`.
+		struct Scope
+		{
+			explicit Scope(FrameArena* arena) : saved { std::exchange(current(), arena) } { }
+			Scope(const Scope&) = delete;
+			~Scope() { current() = saved; }
+		private:
+			FrameArena* saved = nullptr;
+		};
+
+		static FrameArena*& current()
+		{
+			thread_local FrameArena* arena = nullptr;
+			return arena;
+		}
+
+		void* allocate(std::size_t n)
+		{
+			std::size_t total = header_size + round_up(n);
+			if (!top || top->capacity - top->used < total) next_chunk(total);
+
+			auto* h = reinterpret_cast< BlockHeader* >(top->data() + top->used);
+			h->chunk = top;
+			h->prev = top->last;
+			h->live = true;
+			top->last = h;
+			top->used += total;
+			return reinterpret_cast< std::byte* >(h) + header_size;
+		}
+
+		void deallocate(void* p)
+		{
+			auto* h = reinterpret_cast< BlockHeader* >(static_cast< std::byte* >(p) - header_size);
+			h->live = false;
+			if (h->chunk != top) return; // Reclaimed when the chunks above it unwind.
+
+			// Pop every dead block from the top, falling back into older chunks as they empty.
+			while (top)
+			{
+				while (top->last && !top->last->live)
+				{
+					top->used = static_cast< std::size_t >(reinterpret_cast< std::byte* >(top->last) - top->data());
+					top->last = top->last->prev;
+				}
+				if (top->last || !top->prev) break;
+				top = top->prev;
+			}
+		}
+
+		// Number of chunks obtained from the global heap so far.
+		std::size_t chunk_count() const { return chunks; }
+
+	private:
+		struct Chunk;
+		struct BlockHeader
+		{
+			Chunk* chunk;
+			BlockHeader* prev;
+			bool live;
+		};
+		struct Chunk
+		{
+			Chunk* prev;
+			Chunk* next;
+			std::size_t capacity;
+			std::size_t used;
+			BlockHeader* last;
+
+			std::byte* data() { return reinterpret_cast< std::byte* >(this) + chunk_header_size; }
+		};
+
+		static constexpr std::size_t round_up(std::size_t n) { return (n + alignment - 1) & ~(alignment - 1); }
+		static constexpr std::size_t header_size = (sizeof(BlockHeader) + alignment - 1) & ~(alignment - 1);
+		static constexpr std::size_t chunk_header_size = (sizeof(Chunk) + alignment - 1) & ~(alignment - 1);
+
+		void next_chunk(std::size_t total)
+		{
+			// Reuse a spare chunk above `top` when it is big enough, otherwise splice in a new one.
+			Chunk* spare = top ? top->next : head;
+			if (spare && spare->capacity >= total)
+			{
+				top = spare;
+				return;
+			}
+
+			std::size_t capacity = total > chunk_size ? total : chunk_size;
+			auto* c = static_cast< Chunk* >(::operator new(chunk_header_size + capacity));
+			*c = Chunk{ .prev = top, .next = spare, .capacity = capacity, .used = 0, .last = nullptr };
+			if (spare) spare->prev = c;
+			(top ? top->next : head) = c;
+			top = c;
+			++chunks;
+		}
+
+		std::size_t chunk_size;
+		std::size_t chunks = 0;
+		Chunk* head = nullptr;
+		Chunk* top = nullptr;
+	};
+
+	// Promise mixin routing coroutine frames to `FrameArena::current()`, or to the global heap
+	// when no arena is installed. The owning arena is recorded in front of the frame so that
+	// the frame is returned to it regardless of which arena is current when it dies.
+	struct ArenaFrame
+	{
+		static void* operator new(std::size_t n)
+		{
+			FrameArena* arena = FrameArena::current();
+			void* block = arena ? arena->allocate(n + prefix_size) : ::operator new(n + prefix_size);
+			*static_cast< FrameArena** >(block) = arena;
+			return static_cast< std::byte* >(block) + prefix_size;
+		}
+		static void operator delete(void* p, std::size_t)
+		{
+			void* block = static_cast< std::byte* >(p) - prefix_size;
+			if (FrameArena* arena = *static_cast< FrameArena** >(block)) arena->deallocate(block);
+			else ::operator delete(block);
+		}
+
+		// Arena this promise's frame lives in. Drivers re-install it while resuming so that
+		// child frames land in the same arena as the base frame.
+		FrameArena* frame_arena = FrameArena::current();
+
+	private:
+		static constexpr std::size_t prefix_size = FrameArena::alignment;
+	};
 
 	template< class T >
 	struct ParserProc
@@ -17,7 +231,7 @@ namespace coroparse
 		struct Promise;
 		using promise_type = Promise;
 
-		struct Promise
+		struct Promise : ArenaFrame
 		{
 			using CoroHandle = std::coroutine_handle< Promise >;
 
@@ -26,84 +240,39 @@ namespace coroparse
 				return { CoroHandle::from_promise(*this) };
 			}
 			void unhandled_exception() { ex_ptr = std::current_exception(); }
-			void return_value(T&& ret_) { ret = std::forward<T>(ret_); }
+			template < class U = T >
+				requires std::is_convertible_v< U&&, T >
+			void return_value(U&& ret_) { ret.emplace(std::forward<U>(ret_)); }
+			void return_value(ParseError error_) { error = error_; }
 
 			auto initial_suspend() noexcept { return std::suspend_never { }; }
 
 			auto final_suspend() noexcept { return std::suspend_always { }; }
 
-			bool push_token(std::string_view tk) // --> token_delivered
-			{
-				auto coro_handle = CoroHandle::from_promise(*this);
-				if (coro_handle.done()) assert(false && "This probably happens because the coroutine dies before all token are pumped into it.");
-
-				if (expecting_token)
-				{
-					assert(!token.has_value());
-					token = tk;
-					coro_handle.resume();
-					return true;
-				}
-				else
-				{
-					if (!inferior_coro_handle)
-					{
-						// Reaching here means the child coro is finished (i.e. this coro is leaf) but the 
-						// current coro is not ready to consume any token -> Simply advances to the next state.
-						coro_handle.resume();
-						return false;
-					}
-					else
-					{
-						if (inferior_coro_handle.done())
-						{
-							inferior_coro_handle = nullptr;
-							coro_handle.resume();
-							return false;
-						}
-						else return inferior_coro_handle.promise().push_token(tk);
-					}
-				}
-			}
-
-			bool wind_until_end_state() // --> is_done?
-			{
-				auto coro_handle = CoroHandle::from_promise(*this);
-				if (inferior_coro_handle)
-				{
-					if (inferior_coro_handle.promise().wind_until_end_state())
-					{
-						// if child is done, detach
-						inferior_coro_handle = nullptr;
-						return coro_handle.done();
-					}
-					else
-					{
-						return false;
-					}
-				}
-				else // is_leaf
-				{
-					if (coro_handle.done()) return true;
-					coro_handle.resume();
-					return coro_handle.done();
-				}
-			}
+			bool done() { return CoroHandle::from_promise(*this).done(); }
+			void resume() { return CoroHandle::from_promise(*this).resume(); }
 
 			auto await_transform(ParserProc<T>&& parse_proc)
 			{
-				inferior_coro_handle = parse_proc.coro_handle;
+				// The child has already run eagerly up to its first suspension. Splice its active
+				// chain under this frame: `top` now names the child's leaf, so the driver can jump
+				// straight to it instead of walking down from the base on every token.
+				Promise& child_promise = parse_proc.coro_handle.promise();
+				child_promise.prev = this;
+				if (child_promise.error) error = child_promise.error; // Fails along with the child, never resumed.
+				else if (!child_promise.done()) top = child_promise.top;
+
 				struct Awaiter
 				{
 					CoroHandle inferior_coro_handle = nullptr;
-					bool await_ready() { return false; }
+					bool await_ready() { return inferior_coro_handle.done() && !inferior_coro_handle.promise().error; }
 					bool await_suspend( std::coroutine_handle< Promise > )
 					{
 						return true;
 					}
-					decltype(auto) await_resume()
+					T await_resume()
 					{
-						return std::forward<decltype(inferior_coro_handle.promise().ret)>(inferior_coro_handle.promise().ret);
+						return inferior_coro_handle.promise().take_result();
 					}
 				};
 				return Awaiter{ .inferior_coro_handle = parse_proc.coro_handle };
@@ -140,44 +309,135 @@ namespace coroparse
 			std::optional< std::string_view > token = std::nullopt;
 			std::exception_ptr ex_ptr = nullptr;
 
-			T ret;
-			CoroHandle inferior_coro_handle = nullptr;
+			// Empty until `co_return`, so `T` needs neither a default constructor nor copies.
+			std::optional< T > ret;
+			// Set by `co_return ParseError{ }`, or on a frame whose child failed. A failed frame
+			// is finished even though it is not `done()`.
+			std::optional< ParseError > error = std::nullopt;
+
+			// Moves the returned value out, or rethrows what escaped the coroutine body.
+			T take_result()
+			{
+				if (ex_ptr)
+				{
+					std::rethrow_exception(ex_ptr);
+				}
+				if (error) fail_result(*error);
+				assert(ret.has_value());
+				return std::move(*ret);
+			}
+
+			Promise* prev = nullptr; // Awaiting parent frame. nullptr for the base.
+			// Leaf of the chain hanging off this frame as of its last `co_await` on a child,
+			// or this frame itself while it is the leaf. For the base, this is the active frame.
+			Promise* top = this;
 		};
 
-		T result()
+		// Winds the coroutine stack until its active frame waits for a token and returns that
+		// frame, or nullptr once the base has finished. In steady state (the leaf consumed the
+		// last token and asks for another) this is a single check, independent of nesting depth.
+		Promise* seek_accepting_state()
 		{
-			if (!coro_handle.done())
+			Promise& base = coro_handle.promise();
+			Promise* active = innermost(base.top);
+			while (!active->expecting_token)
 			{
-				bool done = false;
-				do {
-					done = coro_handle.promise().wind_until_end_state();
-				} while (!done);
+				if (active->error)
+				{
+					// The frames in between are abandoned, the base finishes with the error.
+					base.error = active->error;
+					active = std::addressof(base);
+					break;
+				}
+				if (active->done())
+				{
+					if (!active->prev) break;
+					// Child finished, continue its parent, which becomes a leaf again.
+					active = active->prev;
+					active->top = active;
+				}
+				active->resume();
+				active = innermost(active); // Descends into a child the frame may just have awaited.
 			}
-			if (coro_handle.promise().ex_ptr)
+			base.top = active;
+			return active->expecting_token ? active : nullptr;
+		}
+		// `base.top` only follows the frames resumed here: a frame resumed with a token that
+		// then awaits a child has its own `top` moved, not the base's, so walk down from it.
+		static Promise* innermost(Promise* frame)
+		{
+			while (frame->top != frame) frame = frame->top;
+			return frame;
+		}
+
+		T result()
+		{
+			finish();
+			return coro_handle.promise().take_result();
+		}
+		// Like `result()`, but a rejected parse is reported as a value instead of failing.
+		Expected< T > try_result()
+		{
+			finish();
+			if (coro_handle.promise().error) return *coro_handle.promise().error;
+			return coro_handle.promise().take_result();
+		}
+		// Tokens pushed after the parser rejected its input are dropped.
+		void push_token(std::string_view tk)
+		{
+			FrameArena::Scope scope { coro_handle.promise().frame_arena };
+			Promise* acceptor = seek_accepting_state();
+			if (!acceptor)
 			{
-				std::rethrow_exception(coro_handle.promise().ex_ptr);
+				assert(failed() && "This probably happens because the coroutine dies before all token are pumped into it.");
+				return;
 			}
-			return coro_handle.promise().ret;
+			acceptor->token = tk;
+			acceptor->resume();
 		}
-		void push_token(std::string_view tk)
+		// True once the parser has rejected its input.
+		bool failed()
 		{
-			bool delivered = false;
-			int __dbg_idx = 1;
-			// Keeps on winding the state machine until the token is consumed.
-			do {
-				delivered = coro_handle.promise().push_token(tk);
-				++__dbg_idx;
-			} while (!delivered);
+			FrameArena::Scope scope { coro_handle.promise().frame_arena };
+			seek_accepting_state();
+			return coro_handle.promise().error.has_value();
+		}
+		// True once no frame asks for tokens any more: the parser finished or rejected its input.
+		bool done()
+		{
+			FrameArena::Scope scope { coro_handle.promise().frame_arena };
+			return !seek_accepting_state();
 		}
 
 		ParserProc(std::coroutine_handle< Promise > ch_) : coro_handle { ch_ } { }
+		ParserProc(ParserProc&& other) noexcept : coro_handle { std::exchange(other.coro_handle, nullptr) } { }
+		ParserProc& operator=(ParserProc&& other) noexcept
+		{
+			if (this != std::addressof(other))
+			{
+				if (coro_handle) coro_handle.destroy();
+				coro_handle = std::exchange(other.coro_handle, nullptr);
+			}
+			return *this;
+		}
 		~ParserProc() { if (coro_handle) coro_handle.destroy(); }
 		
 	private:
+		// Feeds end-of-input (nullopt) to every frame still asking for tokens.
+		void finish()
+		{
+			FrameArena::Scope scope { coro_handle.promise().frame_arena };
+			while (Promise* acceptor = seek_accepting_state())
+			{
+				acceptor->token = std::nullopt;
+				acceptor->resume();
+			}
+		}
+
 		std::coroutine_handle< Promise > coro_handle = nullptr;
 	};
 
-	ParserProc<int> pp(int a)
+	inline ParserProc<int> pp(int a)
 	{
 		if (a == 0)
 		{
@@ -193,7 +453,7 @@ namespace coroparse
 		else
 		{
 			std::cout << "Descend: " << a << std::endl;
-			int r = co_await pp(a - 1);
+			co_await pp(a - 1);
 			auto tk = co_await NextTokenT{};
 			if (tk.has_value()) std::cout << "In parser_proc: " << tk.value() << std::endl;
 		}
@@ -299,7 +559,7 @@ namespace coroparse
 			{ 
 				Promise* self_promise = nullptr;
 				bool await_ready() noexcept { return false; }
-				bool await_suspend(CoroHandle parent_coro) noexcept
+				bool await_suspend(CoroHandle) noexcept
 				{
 					return true;
 				}
@@ -405,7 +665,7 @@ namespace coroparse
 		bool moved_past_initial_suspend = false;
 	};
 
-	Degenerator_<int, const std::string_view> ff(int a)
+	inline Degenerator_<int, const std::string_view> ff(int a)
 	{
 		if (a == 0)
 		{
@@ -435,7 +695,7 @@ namespace coroparse
 	template < class R, class T >
 	struct Degenerator
 	{
-		struct Promise
+		struct Promise : ArenaFrame
 		{
 			using CoroHandle = std::coroutine_handle< Promise >;
 			Degenerator< R, T > get_return_object()
@@ -443,7 +703,10 @@ namespace coroparse
 				return Degenerator<R, T>{ CoroHandle::from_promise(*this) };
 			}
 			void unhandled_exception() { eptr = std::current_exception(); }
-			void return_value(R&& ret_) { ret = std::forward<R>(ret_); }
+			template < class U = R >
+				requires std::is_convertible_v< U&&, R >
+			void return_value(U&& ret_) { ret.emplace(std::forward<U>(ret_)); }
+			void return_value(ParseError error_) { error = error_; }
 
 			bool done() { return CoroHandle::from_promise(*this).done(); }
 			void resume() { return CoroHandle::from_promise(*this).resume(); }
@@ -461,17 +724,29 @@ namespace coroparse
 			struct FinalAwaitable
 			{
 				bool await_ready() noexcept { return false; }
-				bool await_suspend(CoroHandle dying_coro) noexcept
+				// Transfers straight to the parent, which picks up the result in `await_resume`,
+				// instead of returning to the driver loop first.
+				std::coroutine_handle< > await_suspend(CoroHandle dying_coro) noexcept
 				{
 					// Final suspend of the last frame.
-					if (dying_coro.promise().prev == nullptr) return true; 
+					if (dying_coro.promise().prev == nullptr) return std::noop_coroutine(); 
+
+					if (dying_coro.promise().error)
+					{
+						// Rejected: skip every frame up to the base, which finishes with the error.
+						// The abandoned frames stay suspended until the base frame is destroyed.
+						Promise& base = *dying_coro.promise().get_base();
+						base.error = dying_coro.promise().error;
+						base.get_top_as_base() = std::addressof(base);
+						return std::noop_coroutine();
+					}
 
 					Promise& parent_promise = *dying_coro.promise().prev;
 					if (parent_promise.is_base())
 						parent_promise.get_top_as_base() = std::addressof(parent_promise);
 					else
 						parent_promise.get_top_non_base() = std::addressof(parent_promise);
-					return true;
+					return CoroHandle::from_promise(parent_promise);
 				}
 				auto await_resume() noexcept
 				{
@@ -490,7 +765,9 @@ namespace coroparse
 				{
 					Promise* promise = nullptr;
 					bool await_ready() { return false; }
-					bool await_suspend(CoroHandle) { return true; }
+					// Enters the child right away (symmetric transfer) rather than bouncing
+					// through `seek_accepting_state`.
+					CoroHandle await_suspend(CoroHandle) { return CoroHandle::from_promise(*promise); }
 					auto await_resume() { return promise->result(); }
 				};
 				return Awaitable{ std::addressof(dg.handle.promise()) };
@@ -517,10 +794,63 @@ namespace coroparse
 				return NextTokenAwaitable{ };
 			}
 
-			auto result()
+			auto await_transform(NextTokens request)
+			{
+				assert(request.count > 0);
+				struct NextTokensAwaitable
+				{
+					Promise* promise = nullptr;
+					std::size_t count = 0;
+					bool await_ready() { return false; }
+					void await_suspend(CoroHandle coro)
+					{
+						promise = std::addressof(coro.promise());
+						promise->is_expecting_token = true;
+						promise->token = nullptr;
+						promise->token_capacity = count;
+					}
+					std::span< T > await_resume()
+					{
+						promise->is_expecting_token = false;
+						promise->token_capacity = 1;
+						T* first = std::exchange(promise->token, nullptr);
+						return first ? std::span< T >{ first, promise->token_count } : std::span< T >{ };
+					}
+				};
+				return NextTokensAwaitable{ .count = request.count };
+			}
+
+			template < class F >
+			auto await_transform(NextTokenWith< F > request)
+			{
+				struct NextTokenWithAwaitable
+				{
+					Promise* promise = nullptr;
+					F f;
+					bool await_ready() { return false; }
+					void await_suspend(CoroHandle coro)
+					{
+						promise = std::addressof(coro.promise());
+						promise->is_expecting_token = true;
+						promise->token = nullptr;
+					}
+					decltype(auto) await_resume()
+					{
+						promise->is_expecting_token = false;
+						return f(std::exchange(promise->token, nullptr));
+					}
+				};
+				return NextTokenWithAwaitable{ nullptr, std::move(request.f) };
+			}
+
+			// Moves the returned value out: a parent awaiting this frame gets the child's result
+			// without a copy. Can only be taken once.
+			R result()
 			{
 				if (eptr) std::rethrow_exception(eptr);
-				return ret;
+				if (error) fail_result(*error);
+				assert(ret.has_value());
+				return std::move(*ret);
 			}
 
 			bool is_expecting_token = false;
@@ -534,8 +864,13 @@ namespace coroparse
 			Promise* base_or_top = nullptr; 
 
 			T* token = nullptr;
+			std::size_t token_count = 0; // Tokens delivered at `token`.
+			std::size_t token_capacity = 1; // Tokens the pending await can take.
 			std::exception_ptr eptr = nullptr;
-			R ret;
+			std::optional< R > ret; // Empty until `co_return`, so `R` needs no default constructor.
+			// Set by `co_return ParseError{ }`. On the base, also set when any frame was rejected,
+			// in which case the base is finished without being `done()`.
+			std::optional< ParseError > error = std::nullopt;
 		};
 
 		using promise_type = Promise;
@@ -544,31 +879,46 @@ namespace coroparse
 		Promise* seek_accepting_state()
 		{
 			Promise* top_promise = handle.promise().get_top_as_base();
-			// Could have been resumed and thus done by now so must check
-			if (!top_promise->prev && top_promise->done()) return nullptr;
-			while (top_promise && !top_promise->is_expecting_token)
+			while (!top_promise->is_expecting_token)
 			{
-				if (!top_promise->done())
-				{
-					top_promise->resume();
-					top_promise = handle.promise().get_top_as_base();
-				}
-				else
-				{
-					top_promise = top_promise->prev;
-				}
+				// Finished children hand control back to their parent themselves, so only
+				// the base can be found done (or rejected) here.
+				if (top_promise->done() || top_promise->error) return nullptr;
+				top_promise->resume();
+				top_promise = handle.promise().get_top_as_base();
 			}
 			return top_promise;
 		}
 
+		// Tokens pushed after the parser finished or rejected its input are dropped.
 		void push_value(T& value)
 		{
+			FrameArena::Scope scope { handle.promise().frame_arena };
 			Promise* acceptor = seek_accepting_state();
+			if (!acceptor) return;
 			acceptor->token = std::addressof(value);
+			acceptor->token_count = 1;
 			acceptor->resume();
 		}
+		// Delivers `values` in as few resumes as the consumer allows: a frame waiting on
+		// `NextTokens{ n }` receives up to `n` of them at once, one on `NextToken`.
+		void push_values(std::span< T > values)
+		{
+			FrameArena::Scope scope { handle.promise().frame_arena };
+			while (!values.empty())
+			{
+				Promise* acceptor = seek_accepting_state();
+				if (!acceptor) return;
+				std::size_t n = std::min(acceptor->token_capacity, values.size());
+				acceptor->token = values.data();
+				acceptor->token_count = n;
+				acceptor->resume();
+				values = values.subspan(n);
+			}
+		}
 		void push_value(EndTokenT)
 		{
+			FrameArena::Scope scope { handle.promise().frame_arena };
 			Promise* acceptor = seek_accepting_state();
 			do 
 			{ 
@@ -580,23 +930,77 @@ namespace coroparse
 			while (acceptor);
 		}
 
+		// Runs the coroutine to completion and moves its result out. Call once.
 		R result() 
 		{ 
 			push_value(EndToken);
 			return handle.promise().result(); 
 		}
+		// Like `result()`, but a rejected parse is reported as a value instead of failing.
+		Expected< R > try_result()
+		{
+			push_value(EndToken);
+			if (handle.promise().error) return *handle.promise().error;
+			return handle.promise().result();
+		}
+		// True once the parser has rejected its input.
+		bool failed() { return handle.promise().error.has_value(); }
+		// True once the parser finished or rejected its input: further tokens would be dropped.
+		bool done() { return handle.done() || failed(); }
 
 		Degenerator(CoroHandle handle_) : handle { handle_ } 
 		{
 			handle.promise().prev = nullptr;
 			handle.promise().base_or_top = std::addressof(handle.promise());
 		}
+		Degenerator(Degenerator&& other) noexcept : handle { std::exchange(other.handle, nullptr) } { }
+		Degenerator& operator=(Degenerator&& other) noexcept
+		{
+			if (this != std::addressof(other))
+			{
+				if (handle) handle.destroy();
+				handle = std::exchange(other.handle, nullptr);
+			}
+			return *this;
+		}
 		~Degenerator() { if (handle) handle.destroy(); }
 	protected:
 		CoroHandle handle = nullptr;
 	};
 
-	Degenerator<int, const std::string_view> ffa(int a)
+	// PEGTL action delivering the text matched by a rule to the consumer coroutine passed as
+	// parse state, e.g. `template < > struct Action< Error > : PushToken { };`.
+	// The token is a view straight into the parser's input buffer, nothing is copied.
+	// Lifetime: the view is valid until the consumer suspends on its next `co_await NextToken`.
+	// With inputs holding the whole document (`memory_input`, `string_input`, `mmap_input`)
+	// it stays valid for as long as the input object lives; with `buffer_input` and other
+	// streaming inputs the buffer may be refilled afterwards, so the consumer must copy
+	// whatever it keeps across suspensions.
+	struct PushToken
+	{
+		template < class ActionInput, class Coro >
+		static void apply(const ActionInput& in, Coro& coro)
+		{
+			const std::string_view tk = in.string_view();
+			if constexpr (requires { coro.push_token(tk); })
+				coro.push_token(tk);
+			else
+				coro.push_value(tk);
+		}
+	};
+
+	// Hands `tokens` to `coro`, in one resume per batch for a Degenerator on `NextTokens`.
+	// A consumer that finished early simply drops the rest.
+	template < class Coro >
+	void deliver_tokens(Coro& coro, std::span< const std::string_view > tokens)
+	{
+		if constexpr (requires { coro.push_values(tokens); })
+			coro.push_values(tokens);
+		else
+			for (std::size_t i = 0; i < tokens.size() && !coro.done(); ++i) coro.push_token(tokens[i]);
+	}
+
+	inline Degenerator<int, const std::string_view> ffa(int a)
 	{
 		if (a == 0)
 		{
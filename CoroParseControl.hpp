@@ -0,0 +1,290 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <tao/pegtl.hpp>
+
+#include "CoroParse.hpp"
+
+namespace coroparse
+{
+	namespace detail
+	{
+		// Type of the tokens `Coro` takes.
+		template < class Coro >
+		struct TokenOf { using type = std::string_view; };
+		template < class R, class T >
+		struct TokenOf< Degenerator< R, T > > { using type = std::remove_const_t< T >; };
+	}
+
+	// Stands in for the consumer `coro` as a state of a parse with the `transactional`
+	// control: actions push into it as they would into `coro` (`PushToken`, `PushKeyword`,
+	// ...), and the tokens reach `coro` once no backtracking can take them back any more.
+	template < class Coro, class Token = typename detail::TokenOf< Coro >::type >
+	class TokenTransaction
+	{
+	public:
+		explicit TokenTransaction(Coro& coro_) : coro { coro_ } { }
+
+		void push_token(std::string_view tk)
+		{
+			Token value { tk };
+			push_value(value);
+		}
+		void push_value(Token& value)
+		{
+			if (scope != Scope::level) deliver(std::span< Token >(&value, 1));
+			else pending.push_back(value);
+		}
+		// Whether the consumer stopped taking tokens.
+		bool done() { return coro.done(); }
+
+		// Tokens held back, waiting for the rules around them to succeed.
+		std::size_t pending_count() const { return pending.size(); }
+
+	private:
+		template < class Rule > friend struct transactional;
+
+		void deliver(std::span< Token > tokens)
+		{
+			if constexpr (requires { coro.push_values(tokens); })
+				coro.push_values(tokens);
+			else
+				for (std::size_t i = 0; i < tokens.size() && !coro.done(); ++i)
+				{
+					if constexpr (requires { coro.push_token(tokens[i]); }) coro.push_token(tokens[i]);
+					else coro.push_value(tokens[i]);
+				}
+		}
+
+		// Where the parse is. `parse` asks for the top rule to be rewound too, but it is not a
+		// level: its tokens would otherwise wait for the whole parse.
+		enum class Scope : unsigned char { outside, top, level };
+
+		// Only the outermost level writes to the transaction, nested ones just read it: they
+		// are opened for most input bytes, a counter would chain them all through memory.
+		struct Level
+		{
+			std::size_t mark;
+			Scope around;
+		};
+		Level open()
+		{
+			const Level level { pending.size(), scope };
+			if (scope != Scope::level) scope = scope == Scope::outside ? Scope::top : Scope::level;
+			return level;
+		}
+		void commit(const Level& level)
+		{
+			if (level.around == Scope::level) return;
+			scope = level.around;
+			if (pending.empty()) return;
+			deliver(std::span< Token >(pending));
+			pending.clear();
+		}
+		void rollback(const Level& level)
+		{
+			if (pending.size() != level.mark) pending.resize(level.mark);
+			if (level.around != Scope::level) scope = level.around;
+		}
+
+		Coro& coro;
+		std::vector< Token > pending;
+		Scope scope = Scope::outside;
+	};
+
+	namespace detail
+	{
+		template < class T >
+		struct IsTransaction : std::false_type { };
+		template < class Coro, class Token >
+		struct IsTransaction< TokenTransaction< Coro, Token > > : std::true_type { };
+
+		// The first of the states `Is` holds for.
+		template < template< class > class Is, class State, class... States >
+		auto& find_state(State& s, States&... st)
+		{
+			if constexpr (Is< std::remove_cvref_t< State > >::value) return s;
+			else
+			{
+				static_assert(sizeof...(States) > 0, "The control's state object is not among the states of the parse.");
+				return find_state< Is >(st...);
+			}
+		}
+	}
+
+	// Control that makes token delivery follow PEGTL's backtracking. Every rule matched with
+	// `rewind_mode::required` (alternatives of a `sor`, the content of `opt`, each round of
+	// `star`, ...) opens a level in the `TokenTransaction` among the states: the tokens its
+	// actions push are held back, dropped if it fails (or throws) and handed on to the level
+	// around it if it succeeds. Once the outermost level succeeded they go to the consumer, so
+	// actions can sit on rules deep inside alternatives. The first level is taken to be the
+	// top rule (`parse` asks for it to be rewound) and passes tokens on directly: call `parse`
+	// with the default `rewind_mode::required`.
+	template < class Rule >
+	struct transactional : tao::pegtl::normal< Rule >
+	{
+		template < tao::pegtl::apply_mode A, tao::pegtl::rewind_mode M, template< class... > class Action, template< class... > class Control, class ParseInput, class... States >
+		static bool match(ParseInput& in, States&&... st)
+		{
+			using Base = tao::pegtl::normal< Rule >;
+			// Leaves without an action (`one<>`, `ranges<>`, ... mostly) cannot push anything.
+			constexpr bool silent_leaf = std::is_same_v< typename Rule::subs_t, tao::pegtl::empty_list > && std::is_base_of_v< tao::pegtl::nothing< Rule >, Action< Rule > >;
+			if constexpr (M != tao::pegtl::rewind_mode::required || A != tao::pegtl::apply_mode::action || silent_leaf)
+				return Base::template match< A, M, Action, Control >(in, st...);
+			else
+			{
+				auto& tx = detail::find_state< detail::IsTransaction >(st...);
+				const auto level = tx.open();
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+				bool result = false;
+				try
+				{
+					result = Base::template match< A, M, Action, Control >(in, st...);
+				}
+				catch (...)
+				{
+					tx.rollback(level);
+					throw;
+				}
+#else
+				const bool result = Base::template match< A, M, Action, Control >(in, st...);
+#endif
+				if (result) tx.commit(level);
+				else tx.rollback(level);
+				return result;
+			}
+		}
+	};
+
+	enum class EventKind : std::uint8_t { start, success, failure };
+
+	// What `event_control` reports: rule `rule` (an id from the selector) started at `begin`,
+	// or matched [begin, end), or failed after having started at `begin` (where `end` is too).
+	// The pointers point into the input, valid as long as it holds that part: always for
+	// in-memory inputs, until the next `discard` for buffer inputs.
+	struct Event
+	{
+		int rule = -1;
+		EventKind kind = EventKind::start;
+		const char* begin = nullptr;
+		const char* end = nullptr;
+
+		std::string_view text() const { return std::string_view(begin, static_cast< std::size_t >(end - begin)); }
+	};
+
+	// Selector for `event_control`: events for `Rules...`, with their position in the list as id.
+	template < class... Rules >
+	struct EventRules
+	{
+		template < class Rule >
+		static constexpr int id = []
+		{
+			int i = 0;
+			const bool found = ((std::is_same_v< Rule, Rules > || (++i, false)) || ...);
+			return found ? i : -1;
+		}();
+	};
+
+	// Collects the events of a parse with `event_control` (or the `E`s of other event sources)
+	// into batches for `coro`, a consumer of `const E`s: one resume per batch for a Degenerator
+	// on `NextTokens`. `flush()` delivers what is left, `parse_events()` does all of it.
+	template < class Coro, class E = Event, std::size_t Batch = 256 >
+	class EventStream
+	{
+	public:
+		explicit EventStream(Coro& coro_) : coro { coro_ } { }
+
+		void push(const E& e)
+		{
+			batch[count++] = e;
+			if (count == Batch) flush();
+		}
+		void flush()
+		{
+			if (count > 0) coro.push_values(std::span< E >(batch.data(), count));
+			count = 0;
+		}
+
+	private:
+		Coro& coro;
+		std::array< E, Batch > batch;
+		std::size_t count = 0;
+	};
+
+	namespace detail
+	{
+		template < class T >
+		struct IsEventStream : std::false_type { };
+		template < class Coro, class E, std::size_t Batch >
+		struct IsEventStream< EventStream< Coro, E, Batch > > : std::true_type { };
+
+		// `parse` into `stream`, then flush it, also when the parse throws.
+		template < class Grammar, template< class... > class Action, template< class... > class Control, class ParseInput, class Stream >
+		bool parse_into(ParseInput& in, Stream& stream)
+		{
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+			bool matched = false;
+			try
+			{
+				matched = tao::pegtl::parse< Grammar, Action, Control >(in, stream);
+			}
+			catch (...)
+			{
+				stream.flush();
+				throw;
+			}
+#else
+			const bool matched = tao::pegtl::parse< Grammar, Action, Control >(in, stream);
+#endif
+			stream.flush();
+			return matched;
+		}
+	}
+
+	// Turns any grammar into a stream of events without an action per rule: for the rules
+	// `Selector::template id< Rule >` gives a non-negative id for, pushes an `Event` into the
+	// `EventStream` among the states when they start, succeed and fail; the other rules are
+	// matched as by `Base`. Actions still run.
+	//   pegtl::parse< Grammar, pegtl::nothing, event_control< EventRules< Key, Value > >::control >(in, stream);
+	template < class Selector, template< class... > class Base = tao::pegtl::normal >
+	struct event_control
+	{
+		template < class Rule >
+		struct control : Base< Rule >
+		{
+			template < tao::pegtl::apply_mode A, tao::pegtl::rewind_mode M, template< class... > class Action, template< class... > class Control, class ParseInput, class... States >
+			static bool match(ParseInput& in, States&&... st)
+			{
+				constexpr int id = Selector::template id< Rule >;
+				if constexpr (id < 0) return Base< Rule >::template match< A, M, Action, Control >(in, st...);
+				else
+				{
+					auto& stream = detail::find_state< detail::IsEventStream >(st...);
+					const char* const begin = in.current();
+					stream.push(Event { id, EventKind::start, begin, begin });
+					const bool result = Base< Rule >::template match< A, M, Action, Control >(in, st...);
+					if (result) stream.push(Event { id, EventKind::success, begin, in.current() });
+					else stream.push(Event { id, EventKind::failure, begin, begin });
+					return result;
+				}
+			}
+		};
+	};
+
+	// Parses `in` with `Grammar` and hands the events of the rules `Selector` picks to `coro`,
+	// a consumer of `const Event`s. Returns whether `Grammar` matched; parse errors propagate
+	// after the events before them have been delivered.
+	template < class Grammar, class Selector, template< class... > class Action = tao::pegtl::nothing, class ParseInput, class Coro >
+	bool parse_events(ParseInput& in, Coro& coro)
+	{
+		EventStream< Coro > stream { coro };
+		return detail::parse_into< Grammar, Action, event_control< Selector >::template control >(in, stream);
+	}
+}
@@ -0,0 +1,477 @@
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <initializer_list>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <tao/pegtl/contrib/json.hpp>
+#include <tao/pegtl/contrib/json_pointer.hpp>
+
+#include "CoroParse.hpp"
+#include "CoroParseControl.hpp"
+#include "CoroParseScan.hpp"
+
+namespace coroparse
+{
+	enum class JsonKind : std::uint8_t { begin_object, end_object, begin_array, end_array, key, string, number, boolean, null, pointer };
+
+	// One step of a JSON document. `text` points into the input: for keys and strings the
+	// content between the quotes, escapes as they are (see `unescape_json()`); for the other
+	// kinds the literal or the bracket. A `pointer` event comes before a value `parse_json()`
+	// selected, with the JSON pointer that selected it (as given to `JsonPointers`).
+	struct JsonEvent
+	{
+		JsonKind kind = JsonKind::null;
+		std::string_view text;
+	};
+
+	namespace detail
+	{
+		namespace json = tao::pegtl::json;
+
+		struct JsonDocument : tao::pegtl::seq< json::text, tao::pegtl::eof > { };
+
+		template < JsonKind Kind >
+		struct EmitJson
+		{
+			template < class ActionInput, class Stream >
+			static void apply(const ActionInput& in, Stream& stream) { stream.push(JsonEvent { Kind, in.string_view() }); }
+		};
+		// `begin_object` and `begin_array` take the white space after the bracket along.
+		template < JsonKind Kind >
+		struct EmitBracket
+		{
+			template < class ActionInput, class Stream >
+			static void apply(const ActionInput& in, Stream& stream) { stream.push(JsonEvent { Kind, std::string_view(in.begin(), 1) }); }
+		};
+
+		template < class Rule > struct JsonEvents : tao::pegtl::nothing< Rule > { };
+		template < > struct JsonEvents< json::begin_object > : EmitBracket< JsonKind::begin_object > { };
+		template < > struct JsonEvents< json::end_object > : EmitBracket< JsonKind::end_object > { };
+		template < > struct JsonEvents< json::begin_array > : EmitBracket< JsonKind::begin_array > { };
+		template < > struct JsonEvents< json::end_array > : EmitBracket< JsonKind::end_array > { };
+		template < > struct JsonEvents< json::key_content > : EmitJson< JsonKind::key > { };
+		template < > struct JsonEvents< json::string_content > : EmitJson< JsonKind::string > { };
+		template < > struct JsonEvents< json::number > : EmitJson< JsonKind::number > { };
+		template < > struct JsonEvents< json::true_ > : EmitJson< JsonKind::boolean > { };
+		template < > struct JsonEvents< json::false_ > : EmitJson< JsonKind::boolean > { };
+		template < > struct JsonEvents< json::null > : EmitJson< JsonKind::null > { };
+	}
+
+	// Parses the JSON document `in` (white space around it allowed, nothing else) with the
+	// `tao::pegtl::json` grammar and hands its events to `coro`, a consumer of
+	// `const JsonEvent`s, in batches of 256. Returns whether `in` is valid JSON; if it is not,
+	// the events up to the error have been delivered.
+	template < class ParseInput, class Coro >
+	bool parse_json(ParseInput& in, Coro& coro)
+	{
+		EventStream< Coro, JsonEvent > stream { coro };
+		return detail::parse_into< detail::JsonDocument, detail::JsonEvents, tao::pegtl::normal >(in, stream);
+	}
+
+	// Consumer helpers, each taking the next event: `co_await json_expect(JsonKind::begin_array)`
+	// tells whether it is of that kind.
+	inline auto json_expect(JsonKind kind)
+	{
+		return NextTokenWith { [kind](const JsonEvent* e) { return e && e->kind == kind; } };
+	}
+	// `co_await json_key()`: the key if the next event is one, `std::nullopt` otherwise (at
+	// `end_object`, in a loop over the members).
+	inline auto json_key()
+	{
+		return NextTokenWith { [](const JsonEvent* e) { return e && e->kind == JsonKind::key ? std::optional(e->text) : std::nullopt; } };
+	}
+	// `co_await json_string()`: the string if the next event is one (escapes as they are).
+	inline auto json_string()
+	{
+		return NextTokenWith { [](const JsonEvent* e) { return e && e->kind == JsonKind::string ? std::optional(e->text) : std::nullopt; } };
+	}
+	// `co_await json_number< T >()`: the number if the next event is one and it fits a `T`
+	// (`1.5` does not fit an `int`).
+	template < class T = double >
+	auto json_number()
+	{
+		return NextTokenWith { [](const JsonEvent* e) -> std::optional< T >
+		{
+			if (!e || e->kind != JsonKind::number) return std::nullopt;
+			T value { };
+			const char* const end = e->text.data() + e->text.size();
+			const auto [p, ec] = std::from_chars(e->text.data(), end, value);
+			if (ec != std::errc() || p != end) return std::nullopt;
+			return value;
+		} };
+	}
+	// `co_await json_bool()`: the boolean if the next event is one.
+	inline auto json_bool()
+	{
+		return NextTokenWith { [](const JsonEvent* e) { return e && e->kind == JsonKind::boolean ? std::optional(e->text == "true") : std::nullopt; } };
+	}
+
+	// `co_await json_selected()`: the JSON pointer if the next event is a `pointer` one (with
+	// `parse_json()` and `JsonPointers`).
+	inline auto json_selected()
+	{
+		return NextTokenWith { [](const JsonEvent* e) { return e && e->kind == JsonKind::pointer ? std::optional(e->text) : std::nullopt; } };
+	}
+
+	// Skips a value the consumer is not interested in, whatever its nesting:
+	//   for (JsonSkip skip; skip(co_await NextToken); ) { }
+	struct JsonSkip
+	{
+		int depth = 0;
+
+		// Whether the value goes on after `e`.
+		bool operator()(const JsonEvent* e)
+		{
+			if (!e) return false;
+			if (e->kind == JsonKind::begin_object || e->kind == JsonKind::begin_array) ++depth;
+			else if (e->kind == JsonKind::end_object || e->kind == JsonKind::end_array) --depth;
+			return depth > 0;
+		}
+	};
+
+	// Appends the key or string `raw` (as in a `JsonEvent`) to `out` with its escapes decoded,
+	// `\u` ones (surrogate pairs included) to UTF-8. The grammar has checked the escapes;
+	// a lone surrogate becomes U+FFFD.
+	inline void unescape_json(std::string_view raw, std::string& out)
+	{
+		const auto hex4 = [](std::string_view s)
+		{
+			unsigned v = 0;
+			for (char c : s.substr(0, 4)) v = v * 16 + static_cast< unsigned >(c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+			return v;
+		};
+		const auto utf8 = [&out](unsigned cp)
+		{
+			if (cp < 0x80) out += static_cast< char >(cp);
+			else if (cp < 0x800)
+			{
+				out += static_cast< char >(0xC0 | (cp >> 6));
+				out += static_cast< char >(0x80 | (cp & 0x3F));
+			}
+			else if (cp < 0x10000)
+			{
+				out += static_cast< char >(0xE0 | (cp >> 12));
+				out += static_cast< char >(0x80 | ((cp >> 6) & 0x3F));
+				out += static_cast< char >(0x80 | (cp & 0x3F));
+			}
+			else
+			{
+				out += static_cast< char >(0xF0 | (cp >> 18));
+				out += static_cast< char >(0x80 | ((cp >> 12) & 0x3F));
+				out += static_cast< char >(0x80 | ((cp >> 6) & 0x3F));
+				out += static_cast< char >(0x80 | (cp & 0x3F));
+			}
+		};
+
+		out.reserve(out.size() + raw.size());
+		std::size_t i = 0;
+		while (i < raw.size())
+		{
+			const std::size_t escape = raw.find('\\', i);
+			out.append(raw.substr(i, escape - i));
+			if (escape == std::string_view::npos) break;
+			const char c = raw[escape + 1];
+			i = escape + 2;
+			switch (c)
+			{
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u':
+			{
+				unsigned cp = hex4(raw.substr(i));
+				i += 4;
+				if (cp >= 0xD800 && cp < 0xDC00 && raw.substr(i, 2) == "\\u" && hex4(raw.substr(i + 2)) - 0xDC00 < 0x400)
+				{
+					cp = 0x10000 + ((cp - 0xD800) << 10) + (hex4(raw.substr(i + 2)) - 0xDC00);
+					i += 6;
+				}
+				else if (cp >= 0xD800 && cp < 0xE000) cp = 0xFFFD;
+				utf8(cp);
+				break;
+			}
+			default: out += c; break; // `"`, `\`, `/`.
+			}
+		}
+	}
+
+	// The JSON pointers (RFC 6901, `/store/books/0/title`) of the values a consumer wants, as a
+	// tree of reference tokens for `parse_json()`. A string that is not a JSON pointer throws
+	// `std::invalid_argument` when exceptions are available and aborts otherwise; check
+	// untrusted ones with `valid()` first.
+	class JsonPointers
+	{
+	public:
+		JsonPointers(std::initializer_list< std::string_view > pointers) : JsonPointers(std::vector< std::string_view >(pointers)) { }
+		template < class Range >
+		explicit JsonPointers(const Range& pointers)
+		{
+			nodes.emplace_back();
+			for (std::string_view pointer : pointers) add(pointer);
+		}
+
+		struct Node
+		{
+			std::vector< std::pair< std::string, int > > children;
+			int pointer = -1; // Index into `texts` if a pointer ends here.
+		};
+
+		static bool valid(std::string_view pointer)
+		{
+			tao::pegtl::memory_input in(pointer, "JSON pointer");
+			return tao::pegtl::parse< tao::pegtl::seq< tao::pegtl::json_pointer::json_pointer, tao::pegtl::eof > >(in);
+		}
+
+		static constexpr int root = 0;
+		const Node& node(int i) const { return nodes[static_cast< std::size_t >(i)]; }
+		std::string_view text(int pointer) const { return texts[static_cast< std::size_t >(pointer)]; }
+
+		// Node below `parent` for the member `key` (as in the input, escapes included), or -1.
+		int member(int parent, std::string_view key) const
+		{
+			std::string unescaped;
+			if (key.find('\\') != std::string_view::npos)
+			{
+				unescape_json(key, unescaped);
+				key = unescaped;
+			}
+			for (const auto& [token, child] : node(parent).children)
+				if (token == key) return child;
+			return -1;
+		}
+		// Node below `parent` for the array element `index`, or -1.
+		int element(int parent, std::size_t index) const
+		{
+			std::array< char, 24 > digits;
+			const auto end = std::to_chars(digits.data(), digits.data() + digits.size(), index).ptr;
+			return member(parent, std::string_view(digits.data(), static_cast< std::size_t >(end - digits.data())));
+		}
+
+	private:
+		void add(std::string_view pointer)
+		{
+			if (!valid(pointer))
+			{
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+				throw std::invalid_argument("not a JSON pointer: " + std::string(pointer));
+#else
+				std::fprintf(stderr, "coroparse: not a JSON pointer: %.*s\n", static_cast< int >(pointer.size()), pointer.data());
+				std::abort();
+#endif
+			}
+
+			int at = root;
+			std::size_t i = 0;
+			while (i < pointer.size())
+			{
+				// `pointer[i]` is a `/`; `~1` stands for `/` in the token, `~0` for `~`.
+				std::size_t next = pointer.find('/', i + 1);
+				if (next == std::string_view::npos) next = pointer.size();
+				std::string token;
+				for (std::size_t j = i + 1; j < next; ++j)
+				{
+					if (pointer[j] == '~') token += pointer[++j] == '1' ? '/' : '~';
+					else token += pointer[j];
+				}
+				int child = -1;
+				for (const auto& [t, c] : node(at).children)
+					if (t == token) child = c;
+				if (child < 0)
+				{
+					child = static_cast< int >(nodes.size());
+					nodes[static_cast< std::size_t >(at)].children.emplace_back(std::move(token), child);
+					nodes.emplace_back();
+				}
+				at = child;
+				i = next;
+			}
+			if (node(at).pointer < 0)
+			{
+				nodes[static_cast< std::size_t >(at)].pointer = static_cast< int >(texts.size());
+				texts.emplace_back(pointer);
+			}
+		}
+
+		std::vector< Node > nodes;
+		std::vector< std::string > texts;
+	};
+
+	namespace detail
+	{
+		template < class Rule, class ParseInput >
+		bool match_silently(ParseInput& in)
+		{
+			return tao::pegtl::match< Rule, tao::pegtl::apply_mode::nothing, tao::pegtl::rewind_mode::required, tao::pegtl::nothing, tao::pegtl::normal >(in);
+		}
+
+		// Past the closing quote of the string starting after `p`, or nullptr.
+		inline const char* skip_json_string(const char* p, const char* end)
+		{
+			static constexpr std::array< char, 2 > stops { '"', '\\' };
+			while (true)
+			{
+				p = find_first_of(p, end, stops);
+				if (p == end) return nullptr;
+				if (*p == '"') return p + 1;
+				if (end - p < 2) return nullptr;
+				p += 2;
+			}
+		}
+
+		// Skips the value at the start of `in` by looking for where it ends (`skip_balanced`
+		// for objects and arrays, the closing quote for strings), without checking what is in
+		// between. Needs the input in memory.
+		template < class ParseInput >
+		bool skip_json_value(ParseInput& in)
+		{
+			const char* const begin = in.current();
+			const char* const end = in.end();
+			if (begin == end) return false;
+			const char* p = nullptr;
+			if (*begin == '"') p = skip_json_string(begin + 1, end);
+			else if (*begin == '{') p = find_balanced_end< '{', '}' >(begin, end);
+			else if (*begin == '[') p = find_balanced_end< '[', ']' >(begin, end);
+			else
+			{
+				static constexpr std::array< char, 7 > stops { ',', '}', ']', ' ', '\t', '\n', '\r' };
+				p = find_first_of(begin, end, stops);
+				if (p == begin) return false;
+			}
+			if (!p) return false;
+			bump_lines(in, begin, static_cast< std::size_t >(p - begin));
+			return true;
+		}
+
+		// State of a `parse_json()` with pointers: the events go to `stream`, `node` is the
+		// place in `pointers` of the value being matched.
+		template < class Coro >
+		struct JsonSelection
+		{
+			EventStream< Coro, JsonEvent > stream;
+			const JsonPointers& pointers;
+			int node = JsonPointers::root;
+
+			void push(const JsonEvent& e) { stream.push(e); }
+			void flush() { stream.flush(); }
+		};
+
+		// A JSON value, where only what `JsonPointers` asks for is matched by the grammar (with
+		// the `JsonEvents` actions): objects and arrays on the way to a pointer are walked member
+		// by member, everything else is skipped with `skip_json_value()`.
+		struct SelectValue
+		{
+			using rule_t = SelectValue;
+			using subs_t = tao::pegtl::empty_list;
+
+			template < tao::pegtl::apply_mode A, tao::pegtl::rewind_mode M, template< class... > class Action, template< class... > class Control, class ParseInput, class Selection >
+			static bool match(ParseInput& in, Selection& st)
+			{
+				const JsonPointers::Node& node = st.pointers.node(st.node);
+				if (node.pointer >= 0)
+				{
+					st.push(JsonEvent { JsonKind::pointer, st.pointers.text(node.pointer) });
+					return Control< json::value >::template match< A, M, Action, Control >(in, st);
+				}
+				if (node.children.empty() || in.empty()) return skip_json_value(in);
+				if (in.peek_char() == '{') return members< A, M, Action, Control >(in, st);
+				if (in.peek_char() == '[') return elements< A, M, Action, Control >(in, st);
+				return skip_json_value(in);
+			}
+
+		private:
+			using ws = star_class< json::ws >;
+
+			template < tao::pegtl::apply_mode A, tao::pegtl::rewind_mode M, template< class... > class Action, template< class... > class Control, class ParseInput, class Selection >
+			static bool inner(ParseInput& in, Selection& st, int child)
+			{
+				if (child < 0) return skip_json_value(in);
+				const int parent = std::exchange(st.node, child);
+				const bool result = match< A, M, Action, Control >(in, st);
+				st.node = parent;
+				return result;
+			}
+
+			// After each member or element: whether another one follows, or the bracket `close`.
+			template < class ParseInput >
+			static bool next(ParseInput& in, char close, bool& more)
+			{
+				match_silently< ws >(in);
+				if (in.empty()) return false;
+				more = in.peek_char() == ',';
+				if (!more && in.peek_char() != close) return false;
+				in.bump_in_this_line(1);
+				match_silently< ws >(in);
+				return true;
+			}
+
+			template < tao::pegtl::apply_mode A, tao::pegtl::rewind_mode M, template< class... > class Action, template< class... > class Control, class ParseInput, class Selection >
+			static bool members(ParseInput& in, Selection& st)
+			{
+				in.bump_in_this_line(1);
+				match_silently< ws >(in);
+				if (!in.empty() && in.peek_char() == '}')
+				{
+					in.bump_in_this_line(1);
+					return true;
+				}
+				for (bool more = true; more;)
+				{
+					const char* const key = in.current();
+					if (!match_silently< json::key >(in)) return false;
+					const int child = st.pointers.member(st.node, std::string_view(key + 1, static_cast< std::size_t >(in.current() - key - 2)));
+					if (!match_silently< json::name_separator >(in)) return false;
+					if (!inner< A, M, Action, Control >(in, st, child)) return false;
+					if (!next(in, '}', more)) return false;
+				}
+				return true;
+			}
+
+			template < tao::pegtl::apply_mode A, tao::pegtl::rewind_mode M, template< class... > class Action, template< class... > class Control, class ParseInput, class Selection >
+			static bool elements(ParseInput& in, Selection& st)
+			{
+				in.bump_in_this_line(1);
+				match_silently< ws >(in);
+				if (!in.empty() && in.peek_char() == ']')
+				{
+					in.bump_in_this_line(1);
+					return true;
+				}
+				std::size_t index = 0;
+				for (bool more = true; more; ++index)
+				{
+					if (!inner< A, M, Action, Control >(in, st, st.pointers.element(st.node, index))) return false;
+					if (!next(in, ']', more)) return false;
+				}
+				return true;
+			}
+		};
+
+		struct JsonSelectDocument : tao::pegtl::seq< star_class< json::ws >, SelectValue, star_class< json::ws >, tao::pegtl::eof > { };
+	}
+
+	// `parse_json()` for the values `pointers` selects only: each comes as a `pointer` event
+	// followed by its events (a value is delivered whole, pointers below it get no events of
+	// their own). Everything around them is skipped with `skip_balanced` and a string scan,
+	// so a document is only checked for what is on the way to the selected values: a malformed
+	// value elsewhere goes unnoticed as long as its outer brackets and its quotes balance. The
+	// input must be in memory.
+	template < class ParseInput, class Coro >
+	bool parse_json(ParseInput& in, const JsonPointers& pointers, Coro& coro)
+	{
+		detail::JsonSelection< Coro > selection { EventStream< Coro, JsonEvent > { coro }, pointers };
+		return detail::parse_into< detail::JsonSelectDocument, detail::JsonEvents, tao::pegtl::normal >(in, selection);
+	}
+}
@@ -0,0 +1,423 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "CoroParse.hpp"
+#include "CoroParseSchedule.hpp"
+#include "CoroParseStream.hpp"
+
+namespace coroparse
+{
+	// Bounded lock-free queue between exactly one producer thread and one consumer thread.
+	// Each side keeps a private copy of the other side's index and only reloads it when the
+	// ring looks full (or empty), so in steady state a push or pop touches no shared cache line
+	// but the one holding its own index.
+	template < class T, std::size_t Capacity = 4096 >
+	class SpscRing
+	{
+		static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two.");
+
+	public:
+		// Producer side. Fails when the ring is full.
+		bool try_push(const T& value)
+		{
+			const std::size_t t = tail.load(std::memory_order_relaxed);
+			if (t - cached_head == Capacity)
+			{
+				cached_head = head.load(std::memory_order_acquire);
+				if (t - cached_head == Capacity) return false;
+			}
+			slots[t & (Capacity - 1)] = value;
+			tail.store(t + 1, std::memory_order_release);
+			return true;
+		}
+		// Consumer side. Moves up to `out.size()` values into `out`, returns how many.
+		std::size_t try_pop(std::span< T > out)
+		{
+			const std::size_t h = head.load(std::memory_order_relaxed);
+			if (cached_tail - h < out.size()) cached_tail = tail.load(std::memory_order_acquire);
+			const std::size_t n = std::min(out.size(), cached_tail - h);
+			for (std::size_t i = 0; i < n; ++i) out[i] = std::move(slots[(h + i) & (Capacity - 1)]);
+			head.store(h + n, std::memory_order_release);
+			return n;
+		}
+
+		static constexpr std::size_t capacity() { return Capacity; }
+
+	private:
+		static constexpr std::size_t cache_line = 64;
+
+		alignas(cache_line) std::atomic< std::size_t > head { 0 }; // Next slot to pop.
+		std::size_t cached_tail = 0;                               // Consumer's view of `tail`.
+		alignas(cache_line) std::atomic< std::size_t > tail { 0 }; // Next slot to push.
+		std::size_t cached_head = 0;                               // Producer's view of `head`.
+		alignas(cache_line) std::array< T, Capacity > slots { };
+	};
+
+	// Waiting on the other end of a ring: spin briefly, then give the core away.
+	inline void ring_backoff(unsigned& spins)
+	{
+		if (++spins < 64) return;
+		std::this_thread::yield();
+	}
+
+	// Parse state standing in for the consumer on the lexer thread of `pipelined_parse()`:
+	// `PushToken` hands it the tokens, which it queues for the consumer thread.
+	template < std::size_t Capacity >
+	struct PipelineProducer
+	{
+		SpscRing< std::string_view, Capacity >& ring;
+
+		void push_value(std::string_view tk)
+		{
+			unsigned spins = 0;
+			while (!ring.try_push(tk)) ring_backoff(spins);
+		}
+	};
+
+	// Parses `in` with `Rule` on a lexer thread while the calling thread runs the consumer
+	// `coro`: PEGTL and the coroutine work on different cores, connected by an SpscRing of
+	// `Capacity` tokens that the consumer drains up to `batch` tokens at a time (one resume
+	// for a consumer on `NextTokens`).
+	// The lexer runs ahead of the consumer, so `in` must hold the whole document
+	// (`memory_input`, `string_input`, `mmap_input`; not `buffer_input`), and `Action` must
+	// deliver tokens through `PushToken`: its parse state is a PipelineProducer, not `coro`.
+	// Worth it when both the grammar and the consumer are expensive; for cheap consumers the
+	// hand-off costs more than it saves. Exceptions thrown by the parse are rethrown here.
+	template < class Rule, template< class... > class Action = tao::pegtl::nothing, std::size_t Capacity = 4096, class Input, class Coro >
+	bool pipelined_parse(Input& in, Coro& coro, std::size_t batch = 256)
+	{
+		SpscRing< std::string_view, Capacity > ring;
+		std::atomic< bool > finished { false };
+		bool ok = false;
+		std::exception_ptr ex_ptr = nullptr;
+
+		std::thread lexer { [&]
+		{
+			PipelineProducer< Capacity > producer { ring };
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+			try
+			{
+				ok = tao::pegtl::parse< Rule, Action >(in, producer);
+			}
+			catch (...)
+			{
+				ex_ptr = std::current_exception();
+			}
+#else
+			ok = tao::pegtl::parse< Rule, Action >(in, producer);
+#endif
+			finished.store(true, std::memory_order_release);
+		} };
+
+		std::array< std::string_view, 1024 > tokens;
+		const std::span< std::string_view > window(tokens.data(), std::min(batch, tokens.size()));
+		unsigned spins = 0;
+		while (true)
+		{
+			// Checked before popping: once it is set, an empty pop means the ring is drained.
+			const bool last = finished.load(std::memory_order_acquire);
+			const std::size_t n = ring.try_pop(window);
+			if (n > 0)
+			{
+				spins = 0;
+				deliver_tokens(coro, std::span< const std::string_view >(tokens.data(), n));
+			}
+			else if (last) break;
+			else ring_backoff(spins);
+		}
+		lexer.join();
+
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+		if (ex_ptr) std::rethrow_exception(ex_ptr);
+#endif
+		return ok;
+	}
+
+	// Runs `f(i)` for every `i` below `count` on the workers of `executor` and waits for all of
+	// them. Not to be called from a task of `executor`. The first exception thrown (in index
+	// order) is rethrown once every call is done.
+	template < class F >
+	void parallel_for(Executor& executor, std::size_t count, F&& f)
+	{
+		std::vector< std::exception_ptr > errors(count);
+		// Shared with the tasks: the last one still notifies through it after the wait below
+		// may have seen zero and returned.
+		const auto remaining = std::make_shared< std::atomic< std::size_t > >(count);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			executor.submit([&f, &errors, remaining, i]
+			{
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+				try
+				{
+					f(i);
+				}
+				catch (...)
+				{
+					errors[i] = std::current_exception();
+				}
+#else
+				f(i);
+#endif
+				if (remaining->fetch_sub(1) == 1) remaining->notify_all();
+			});
+		}
+		while (const std::size_t n = remaining->load()) remaining->wait(n);
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+		for (std::exception_ptr& e : errors)
+			if (e) std::rethrow_exception(e);
+#endif
+	}
+
+	// Cuts `text` into at most `chunks` pieces of about equal size, each ending right after a
+	// `delimiter` (the last one at the end of `text`), so that no record straddles two pieces.
+	// Pieces are at least `min_size` bytes, except where `text` is shorter.
+	inline std::vector< std::string_view > split_records(std::string_view text, std::size_t chunks, char delimiter = '\n', std::size_t min_size = 64 * 1024)
+	{
+		chunks = std::max< std::size_t >(1, std::min(chunks, text.size() / std::max< std::size_t >(1, min_size)));
+		std::vector< std::string_view > pieces;
+		std::size_t begin = 0;
+		for (std::size_t i = 1; i <= chunks && begin < text.size(); ++i)
+		{
+			std::size_t end = text.size();
+			if (i < chunks)
+			{
+				const std::size_t cut = std::max(begin, text.size() / chunks * i);
+				const std::size_t delim = text.find(delimiter, cut);
+				end = delim == std::string_view::npos ? text.size() : delim + 1;
+			}
+			pieces.push_back(text.substr(begin, end - begin));
+			begin = end;
+		}
+		return pieces;
+	}
+
+	// Outcome of one chunk of `parallel_parse()`.
+	template < class R >
+	struct ChunkResult
+	{
+		std::string_view text;
+		bool matched;      // Whether the grammar matched the whole chunk.
+		Expected< R > value;
+	};
+
+	// Parses a record-oriented document (newline-delimited logs, JSON Lines, ...) on all
+	// workers of `executor`. The text is split with `split_records()` into a few chunks per
+	// worker; each chunk is parsed as `StreamOf< Rule >` (`Rule` matches one record, including
+	// its delimiter) into a consumer of its own, made by `make_consumer()` on the worker that
+	// parses the chunk, so it is called concurrently. The results come back in input order,
+	// ready to be merged. Blocks until every chunk is done; not to be called from a task of
+	// `executor`. Positions reported by PEGTL are relative to the chunk. Exceptions thrown by
+	// a parse are rethrown here.
+	template < class Rule, template< class... > class Action = tao::pegtl::nothing, class MakeConsumer >
+	auto parallel_parse(Executor& executor, std::string_view text, MakeConsumer make_consumer, char delimiter = '\n', std::size_t min_chunk = 64 * 1024)
+	{
+		using Consumer = decltype(make_consumer());
+		using R = typename SessionTraits< Consumer >::Result;
+
+		const std::vector< std::string_view > pieces = split_records(text, executor.worker_count() * 4, delimiter, min_chunk);
+		std::vector< std::optional< ChunkResult< R > > > slots(pieces.size());
+		parallel_for(executor, pieces.size(), [&](std::size_t i)
+		{
+			Consumer consumer = make_consumer();
+			tao::pegtl::memory_input< tao::pegtl::tracking_mode::lazy > in(pieces[i], "chunk " + std::to_string(i));
+			const bool matched = tao::pegtl::parse< StreamOf< Rule >, Action >(in, consumer);
+			slots[i].emplace(ChunkResult< R > { pieces[i], matched, consumer.try_result() });
+		});
+
+		std::vector< ChunkResult< R > > results;
+		results.reserve(pieces.size());
+		for (auto& slot : slots) results.push_back(std::move(*slot));
+		return results;
+	}
+
+	// `parallel_parse()` over a memory mapped file.
+	template < class Rule, template< class... > class Action = tao::pegtl::nothing, class MakeConsumer >
+	auto parallel_parse(Executor& executor, tao::pegtl::mmap_input<>& in, MakeConsumer make_consumer, char delimiter = '\n', std::size_t min_chunk = 64 * 1024)
+	{
+		return parallel_parse< Rule, Action >(executor, std::string_view(in.begin(), in.size()), std::move(make_consumer), delimiter, min_chunk);
+	}
+
+	// Parse state recording the tokens of a speculatively parsed chunk, see `speculative_parse()`.
+	struct TokenRecorder
+	{
+		std::vector< std::string_view > tokens;
+
+		void push_value(std::string_view tk) { tokens.push_back(tk); }
+	};
+
+	// Outcome of `speculative_parse()`.
+	struct SpeculativeResult
+	{
+		bool matched = false;
+		std::size_t chunks = 0;   // Chunks the list was split into.
+		std::size_t reparsed = 0; // Chunks whose guessed start was wrong and were parsed again.
+	};
+
+	namespace detail
+	{
+		// Items of a `list< Item, Separator >` from `start` on, stopping after the first
+		// separator that ends at or beyond `target`. As in `list<>`, a separator not followed by
+		// an item is not part of the list.
+		struct ListChunk
+		{
+			std::size_t start = 0;
+			std::size_t end = 0;       // Where the next item (or the list's tail) begins.
+			std::size_t separator = 0; // Where the separator before `end` begins, unless `last`.
+			std::size_t items = 0;
+			bool failed = false;       // The first item did not match.
+			bool last = false;         // No item after the last one: the list ends at `end`.
+			TokenRecorder recorder;
+		};
+
+		template < class Rule, template< class... > class Action, class State >
+		bool match_at(std::string_view text, std::size_t& pos, State& state)
+		{
+			tao::pegtl::memory_input< tao::pegtl::tracking_mode::lazy > in(text.data() + pos, text.data() + text.size(), "speculative");
+			if (!tao::pegtl::parse< Rule, Action >(in, state)) return false;
+			pos = static_cast< std::size_t >(in.current() - text.data());
+			return true;
+		}
+
+		template < class Item, class Separator, template< class... > class Action >
+		ListChunk parse_list_chunk(std::string_view text, std::size_t start, std::size_t target)
+		{
+			ListChunk c;
+			c.start = start;
+			std::size_t pos = start;
+			while (pos < target)
+			{
+				if (!match_at< Item, Action >(text, pos, c.recorder))
+				{
+					// Back over the separator before it; the chunk's first item is decided by
+					// the caller, the separator before it ended the previous chunk.
+					if (c.items > 0)
+					{
+						pos = c.separator;
+						c.last = true;
+					}
+					else c.failed = true;
+					break;
+				}
+				++c.items;
+				c.separator = pos;
+				if (!match_at< Separator, Action >(text, pos, c.recorder))
+				{
+					c.last = true;
+					break;
+				}
+			}
+			c.end = pos;
+			return c;
+		}
+	}
+
+	// Parses `seq< Head, opt< list< Item, Separator > >, Tail, eof >` on all workers of `executor`,
+	// e.g. a single huge JSON array. There are no safe split points in such a document, so
+	// they are guessed: the list is cut into chunks of about `min_chunk` bytes or more, each
+	// chunk is assumed to start right after the first match of `Separator` past the cut, and
+	// the chunks are parsed in parallel from these guesses into TokenRecorders.
+	// The guess is validated afterwards, in order: a chunk is kept if it started where the
+	// previous one really ended, otherwise (a separator inside a string literal, say) it is
+	// parsed again from the right place. The items matched, and the tokens `coro` receives,
+	// are therefore exactly those of a sequential parse, only the work may be done twice.
+	// Like `pipelined_parse()`, `Action` must deliver tokens through `PushToken` and must not
+	// have other side effects: actions of a discarded guess run too. Exceptions thrown by
+	// speculative chunks are ignored; when the chunk has to be parsed for real they are thrown
+	// again. Grammars that are not a list at their top (e.g. `ex::Error`'s nesting) gain
+	// nothing here and should use `pipelined_parse()`.
+	template < class Head, class Item, class Separator, class Tail, template< class... > class Action = tao::pegtl::nothing, class Coro >
+	SpeculativeResult speculative_parse(Executor& executor, std::string_view text, Coro& coro, std::size_t min_chunk = 64 * 1024)
+	{
+		SpeculativeResult result;
+		TokenRecorder head;
+		std::size_t pos = 0;
+		if (!detail::match_at< Head, Action >(text, pos, head)) return result;
+		deliver_tokens(coro, head.tokens);
+
+		// Guessed chunk starts. Cut points whose guess lands on or before the previous one
+		// are dropped, so the guesses are strictly increasing.
+		const std::size_t list_begin = pos;
+		const std::size_t chunks = std::max< std::size_t >(1, std::min(executor.worker_count() * 4, (text.size() - list_begin) / std::max< std::size_t >(1, min_chunk)));
+		std::vector< std::size_t > starts { list_begin };
+		for (std::size_t i = 1; i < chunks; ++i)
+		{
+			for (std::size_t p = std::max(starts.back() + 1, list_begin + (text.size() - list_begin) / chunks * i); p < text.size(); ++p)
+			{
+				std::size_t q = p;
+				TokenRecorder ignored;
+				if (detail::match_at< Separator, tao::pegtl::nothing >(text, q, ignored))
+				{
+					starts.push_back(q);
+					break;
+				}
+			}
+		}
+		result.chunks = starts.size();
+		auto target = [&](std::size_t i) { return i + 1 < starts.size() ? starts[i + 1] : text.size(); };
+
+		std::vector< detail::ListChunk > guesses(starts.size());
+		parallel_for(executor, starts.size(), [&](std::size_t i)
+		{
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+			try
+			{
+				guesses[i] = detail::parse_list_chunk< Item, Separator, Action >(text, starts[i], target(i));
+			}
+			catch (...)
+			{
+				guesses[i].start = starts[i];
+				guesses[i].failed = true;
+			}
+#else
+			guesses[i] = detail::parse_list_chunk< Item, Separator, Action >(text, starts[i], target(i));
+#endif
+		});
+
+		bool empty = true;
+		std::size_t separator = pos; // Where the separator that ended the previous chunk begins.
+		for (std::size_t i = 0; i < starts.size(); ++i)
+		{
+			if (pos >= target(i)) continue; // The previous chunk ran past this one.
+			detail::ListChunk& guess = guesses[i];
+			detail::ListChunk redone;
+			detail::ListChunk* chunk = &guess;
+			if (guess.start != pos || guess.failed)
+			{
+				++result.reparsed;
+				redone = detail::parse_list_chunk< Item, Separator, Action >(text, pos, target(i));
+				chunk = &redone;
+			}
+			deliver_tokens(coro, chunk->recorder.tokens);
+			if (chunk->failed)
+			{
+				// `opt< list<> >` matches nothing when the very first item fails; otherwise the
+				// list ends before the separator that was not followed by an item.
+				if (!empty) pos = separator;
+				break;
+			}
+			empty = false;
+			pos = chunk->end;
+			separator = chunk->separator;
+			if (chunk->last) break;
+		}
+
+		TokenRecorder tail;
+		result.matched = detail::match_at< tao::pegtl::seq< Tail, tao::pegtl::eof >, Action >(text, pos, tail);
+		deliver_tokens(coro, tail.tokens);
+		return result;
+	}
+}
@@ -0,0 +1,460 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include <tao/pegtl/contrib/analyze_traits.hpp>
+
+#include "CoroParse.hpp"
+#include "CoroParseScan.hpp"
+
+namespace coroparse
+{
+	// Bytes a rule can start with, and whether it can succeed without consuming any.
+	// An over-approximation: rules it does not understand can start with anything.
+	struct FirstSet
+	{
+		std::array< bool, 256 > bytes { };
+		bool nullable = false;
+
+		static constexpr FirstSet anything(bool nullable)
+		{
+			FirstSet f;
+			f.bytes.fill(true);
+			f.nullable = nullable;
+			return f;
+		}
+		static constexpr FirstSet empty() { return FirstSet { { }, true }; }
+
+		constexpr void add_bytes(const FirstSet& other)
+		{
+			for (std::size_t i = 0; i < 256; ++i) bytes[i] = bytes[i] || other.bytes[i];
+		}
+	};
+
+	namespace detail
+	{
+		namespace pi = tao::pegtl::internal;
+
+		// Keyed on `rule_t`, i.e. on PEGTL's internal rule types. Anything else may do anything:
+		// custom rules, `must<>` and `raise<>` (which throw instead of failing), `until<>`, ...
+		template < class RuleT >
+		struct FirstOf
+		{
+			static constexpr FirstSet value = FirstSet::anything(true);
+		};
+
+		template < class Rule >
+		constexpr FirstSet first_set() { return FirstOf< typename Rule::rule_t >::value; }
+
+		// Rules are only looked at up to the first one that cannot match empty, so recursive
+		// grammars terminate (left recursion, which PEG does not allow anyway, does not).
+		template < class Rule, class... Rules >
+		constexpr FirstSet first_of_seq()
+		{
+			constexpr FirstSet head = first_set< Rule >();
+			if constexpr (head.nullable && sizeof...(Rules) > 0)
+			{
+				FirstSet f = first_of_seq< Rules... >();
+				f.add_bytes(head);
+				return f;
+			}
+			else return head;
+		}
+
+		template < class... Rules >
+		constexpr FirstSet first_of_sor()
+		{
+			FirstSet f;
+			((f.add_bytes(first_set< Rules >()), f.nullable = f.nullable || first_set< Rules >().nullable), ...);
+			return f;
+		}
+
+		template < class RuleT >
+		constexpr FirstSet first_of_class()
+		{
+			if constexpr (std::is_same_v< typename RuleT::peek_t, pi::peek_char >)
+			{
+				FirstSet f;
+				for (std::size_t i = 0; i < 256; ++i) f.bytes[i] = RuleT::test(static_cast< char >(i));
+				return f;
+			}
+			else return FirstSet::anything(false); // UTF-8 and friends: some byte, at least.
+		}
+
+		template < pi::result_on_found R, class Peek, typename Peek::data_t... Cs >
+		struct FirstOf< pi::one< R, Peek, Cs... > > { static constexpr FirstSet value = first_of_class< pi::one< R, Peek, Cs... > >(); };
+		template < pi::result_on_found R, class Peek, typename Peek::data_t Lo, typename Peek::data_t Hi >
+		struct FirstOf< pi::range< R, Peek, Lo, Hi > > { static constexpr FirstSet value = first_of_class< pi::range< R, Peek, Lo, Hi > >(); };
+		template < class Peek, typename Peek::data_t... Cs >
+		struct FirstOf< pi::ranges< Peek, Cs... > > { static constexpr FirstSet value = first_of_class< pi::ranges< Peek, Cs... > >(); };
+		template < class Peek >
+		struct FirstOf< pi::any< Peek > > { static constexpr FirstSet value = FirstSet::anything(false); };
+
+		template < char C, char... Cs >
+		struct FirstOf< pi::string< C, Cs... > >
+		{
+			static constexpr FirstSet value = []
+			{
+				FirstSet f;
+				f.bytes[static_cast< unsigned char >(C)] = true;
+				return f;
+			}();
+		};
+		template < char C, char... Cs >
+		struct FirstOf< pi::istring< C, Cs... > >
+		{
+			static constexpr FirstSet value = []
+			{
+				FirstSet f;
+				f.bytes[static_cast< unsigned char >(C)] = true;
+				if ((C | 0x20) >= 'a' && (C | 0x20) <= 'z')
+				{
+					f.bytes[static_cast< unsigned char >(C | 0x20)] = true;
+					f.bytes[static_cast< unsigned char >(C & ~0x20)] = true;
+				}
+				return f;
+			}();
+		};
+
+		template < class... Rules >
+		struct FirstOf< pi::seq< Rules... > >
+		{
+			static constexpr FirstSet value = []
+			{
+				if constexpr (sizeof...(Rules) == 0) return FirstSet::empty();
+				else return first_of_seq< Rules... >();
+			}();
+		};
+		template < class... Rules >
+		struct FirstOf< pi::sor< Rules... > > { static constexpr FirstSet value = first_of_sor< Rules... >(); };
+		template < class Rule >
+		struct FirstOf< pi::plus< Rule > > { static constexpr FirstSet value = first_set< Rule >(); };
+		template < class Rule >
+		struct FirstOf< pi::opt< Rule > >
+		{
+			static constexpr FirstSet value = [] { FirstSet f = first_set< Rule >(); f.nullable = true; return f; }();
+		};
+		template < class Rule >
+		struct FirstOf< pi::star< Rule > > : FirstOf< pi::opt< Rule > > { };
+		template < unsigned Cnt, class Rule >
+		struct FirstOf< pi::rep< Cnt, Rule > > { static constexpr FirstSet value = first_set< Rule >(); };
+		template < unsigned Min, unsigned Max, class Rule >
+		struct FirstOf< pi::rep_min_max< Min, Max, Rule > >
+		{
+			static constexpr FirstSet value = [] { FirstSet f = first_set< Rule >(); f.nullable = f.nullable || Min == 0; return f; }();
+		};
+
+		// Wrappers that change how their rules run, not what they match.
+		template < template< class... > class Action, class... Rules >
+		struct FirstOf< pi::action< Action, Rules... > > : FirstOf< pi::seq< Rules... > > { };
+		template < template< class... > class Control, class... Rules >
+		struct FirstOf< pi::control< Control, Rules... > > : FirstOf< pi::seq< Rules... > > { };
+		template < class State, class... Rules >
+		struct FirstOf< pi::state< State, Rules... > > : FirstOf< pi::seq< Rules... > > { };
+		template < class... Rules >
+		struct FirstOf< pi::enable< Rules... > > : FirstOf< pi::seq< Rules... > > { };
+		template < class... Rules >
+		struct FirstOf< pi::disable< Rules... > > : FirstOf< pi::seq< Rules... > > { };
+
+		// Consume nothing.
+		template < > struct FirstOf< pi::success > { static constexpr FirstSet value = FirstSet::empty(); };
+		template < > struct FirstOf< pi::failure > { static constexpr FirstSet value = FirstSet { }; };
+		template < > struct FirstOf< pi::eof > { static constexpr FirstSet value = FirstSet::empty(); };
+		template < > struct FirstOf< pi::bof > { static constexpr FirstSet value = FirstSet::empty(); };
+		template < > struct FirstOf< pi::bol > { static constexpr FirstSet value = FirstSet::empty(); };
+		template < > struct FirstOf< pi::discard > { static constexpr FirstSet value = FirstSet::empty(); };
+		template < class... Rules >
+		struct FirstOf< pi::at< Rules... > > { static constexpr FirstSet value = FirstSet::empty(); };
+		template < class... Rules >
+		struct FirstOf< pi::not_at< Rules... > > { static constexpr FirstSet value = FirstSet::empty(); };
+
+		template < std::size_t Min, class... Classes >
+		struct FirstOf< ClassRun< Min, Classes... > >
+		{
+			static constexpr FirstSet value = [] { FirstSet f = first_of_sor< Classes... >(); f.nullable = Min == 0; return f; }();
+		};
+		template < char Open, char Close, char Quote, char Escape >
+		struct FirstOf< skip_balanced< Open, Close, Quote, Escape > >
+		{
+			static constexpr FirstSet value = []
+			{
+				FirstSet f;
+				f.bytes[static_cast< unsigned char >(Open)] = true;
+				return f;
+			}();
+		};
+	}
+
+	template < class Rule >
+	inline constexpr FirstSet first_set_v = detail::first_set< Rule >();
+
+	// `sor< Rules... >` that looks at the next byte first and only tries the alternatives that
+	// can start with it (or match empty), through a 256-entry table computed from the FIRST sets
+	// of the alternatives at compile time. `dispatch_sor< json::string, json::number, json::object,
+	// json::array, json::false_, json::true_, json::null >` goes straight to the one alternative
+	// that can match, instead of failing through up to six others with a marker each.
+	// Matches, actions and errors are those of `sor`; only the control's `start`/`failure`
+	// notifications of alternatives that were skipped do not happen. At most 64 alternatives.
+	template < class... Rules >
+	struct dispatch_sor
+	{
+		static_assert(sizeof...(Rules) > 0 && sizeof...(Rules) <= 64);
+
+		using rule_t = dispatch_sor;
+		using subs_t = tao::pegtl::type_list< Rules... >;
+
+		// Candidate alternatives per next byte, one bit each; the last entry is for end of input.
+		static constexpr std::array< std::uint64_t, 257 > table = []
+		{
+			std::array< std::uint64_t, 257 > t { };
+			const FirstSet firsts[] = { first_set_v< Rules >... };
+			for (std::size_t r = 0; r < sizeof...(Rules); ++r)
+			{
+				const std::uint64_t bit = std::uint64_t(1) << r;
+				for (std::size_t c = 0; c < 256; ++c)
+					if (firsts[r].nullable || firsts[r].bytes[c]) t[c] |= bit;
+				if (firsts[r].nullable) t[256] |= bit;
+			}
+			return t;
+		}();
+
+		template < tao::pegtl::apply_mode A, tao::pegtl::rewind_mode M, template< class... > class Action, template< class... > class Control, class ParseInput, class... States >
+		static bool match(ParseInput& in, States&&... st)
+		{
+			const std::uint64_t candidates = in.size(1) == 0 ? table[256] : table[static_cast< unsigned char >(in.peek_char())];
+			return match< A, Action, Control >(std::index_sequence_for< Rules... >(), candidates, in, st...);
+		}
+
+	private:
+		template < tao::pegtl::apply_mode A, template< class... > class Action, template< class... > class Control, std::size_t... Is, class ParseInput, class... States >
+		static bool match(std::index_sequence< Is... >, std::uint64_t candidates, ParseInput& in, States&&... st)
+		{
+			return ((((candidates >> Is) & 1) != 0 && Control< Rules >::template match< A, tao::pegtl::rewind_mode::required, Action, Control >(in, st...)) || ...);
+		}
+	};
+
+	namespace detail
+	{
+		template < class RuleT >
+		struct KeywordChars
+		{
+			static_assert(sizeof(RuleT) == 0, "Keywords are non-empty `string<>`s and `istring<>`s.");
+		};
+		template < char... Cs >
+		struct KeywordChars< pi::string< Cs... > >
+		{
+			static constexpr std::array< char, sizeof...(Cs) > chars { Cs... };
+			static constexpr bool fold = false;
+		};
+		template < char... Cs >
+		struct KeywordChars< pi::istring< Cs... > >
+		{
+			static constexpr std::array< char, sizeof...(Cs) > chars { Cs... };
+			static constexpr bool fold = true;
+		};
+
+		constexpr bool keyword_char_matches(char k, bool fold, char c)
+		{
+			const char lower = static_cast< char >(k | 0x20);
+			return c == k || (fold && lower >= 'a' && lower <= 'z' && static_cast< char >(c | 0x20) == lower);
+		}
+
+		// Keywords bucketed by the bytes they can start with, longest first, and compared with
+		// the input 8 bytes at a time: `(input | fold) & mask == pattern`, where `fold` sets the
+		// case bit of the letters of `istring`s, `pattern` holds them in lower case and `mask`
+		// drops the bytes past the end of the keyword. A candidate carries its first 8 bytes,
+		// so most keywords are checked with one load from the table.
+		template < class... Keywords >
+		struct KeywordTable
+		{
+			static constexpr std::size_t count = sizeof...(Keywords);
+			static constexpr std::size_t max_length = std::max({ KeywordChars< typename Keywords::rule_t >::chars.size()... });
+			static_assert(count > 0 && count < 65536 && max_length < 65536);
+
+			static constexpr std::array< std::string_view, count > words { std::string_view(KeywordChars< typename Keywords::rule_t >::chars.data(), KeywordChars< typename Keywords::rule_t >::chars.size())... };
+			static constexpr std::array< bool, count > folds { KeywordChars< typename Keywords::rule_t >::fold... };
+			// 8-byte words past the first ones.
+			static constexpr std::size_t more_words = (((KeywordChars< typename Keywords::rule_t >::chars.size() + 7) / 8 - 1) + ...);
+
+			static constexpr bool contains(char c)
+			{
+				for (std::size_t k = 0; k < count; ++k)
+					for (char ch : words[k])
+						if (keyword_char_matches(ch, folds[k], c)) return true;
+				return false;
+			}
+
+			struct Word
+			{
+				std::uint64_t pattern = 0;
+				std::uint64_t fold = 0;
+				std::uint64_t mask = 0;
+			};
+			struct Candidate
+			{
+				Word first;
+				std::uint16_t id = 0;
+				std::uint16_t length = 0;
+				std::uint32_t more = 0; // Index of the next 8 bytes in `more`, for longer keywords.
+			};
+			struct Tables
+			{
+				std::array< std::uint16_t, 257 > bucket { }; // Candidates for byte `b` are [bucket[b], bucket[b + 1]).
+				std::array< Candidate, 2 * count > candidates { };
+				std::array< Word, more_words + 1 > more { };
+			};
+
+			// Bytes [offset, offset + 8) of keyword `k`, in the layout of a `memcpy` from the input.
+			static constexpr Word word_of(std::size_t k, std::size_t offset)
+			{
+				Word w;
+				for (std::size_t i = 0; i < 8 && offset + i < words[k].size(); ++i)
+				{
+					const char c = words[k][offset + i];
+					const bool letter = folds[k] && keyword_char_matches(c, true, static_cast< char >(c ^ 0x20));
+					const int shift = static_cast< int >(8 * (std::endian::native == std::endian::little ? i : 7 - i));
+					w.pattern |= std::uint64_t(static_cast< unsigned char >(letter ? c | 0x20 : c)) << shift;
+					w.fold |= std::uint64_t(letter ? 0x20 : 0) << shift;
+					w.mask |= std::uint64_t(0xff) << shift;
+				}
+				return w;
+			}
+
+			static constexpr Tables tables = []
+			{
+				Tables t;
+				std::array< std::uint32_t, count > more { };
+				std::size_t m = 0;
+				for (std::size_t k = 0; k < count; ++k)
+				{
+					more[k] = static_cast< std::uint32_t >(m);
+					for (std::size_t offset = 8; offset < words[k].size(); offset += 8) t.more[m++] = word_of(k, offset);
+				}
+
+				std::size_t n = 0;
+				for (std::size_t b = 0; b < 256; ++b)
+				{
+					t.bucket[b] = static_cast< std::uint16_t >(n);
+					for (std::size_t length = max_length; length > 0; --length)
+						for (std::size_t k = 0; k < count; ++k)
+							if (words[k].size() == length && keyword_char_matches(words[k][0], folds[k], static_cast< char >(b)))
+								t.candidates[n++] = Candidate { word_of(k, 0), static_cast< std::uint16_t >(k), static_cast< std::uint16_t >(length), more[k] };
+				}
+				t.bucket[256] = static_cast< std::uint16_t >(n);
+				return t;
+			}();
+
+			static std::uint64_t load(const char* p, std::size_t available)
+			{
+				std::uint64_t x = 0;
+				std::memcpy(&x, p, available >= 8 ? 8 : available);
+				return x;
+			}
+
+			struct Match
+			{
+				std::size_t length = 0;
+				int id = -1;
+			};
+			// Longest keyword at the start of [p, p + n).
+			static Match longest(const char* p, std::size_t n)
+			{
+				if (n == 0) return { };
+				const auto b = static_cast< unsigned char >(*p);
+				const std::uint64_t head = load(p, n);
+				for (std::size_t c = tables.bucket[b]; c < tables.bucket[b + 1]; ++c)
+				{
+					const Candidate& k = tables.candidates[c];
+					if (k.length > n || ((head | k.first.fold) & k.first.mask) != k.first.pattern) continue;
+					bool same = true;
+					for (std::size_t offset = 8, i = k.more; offset < k.length && same; offset += 8, ++i)
+					{
+						const Word& w = tables.more[i];
+						same = ((load(p + offset, n - offset) | w.fold) & w.mask) == w.pattern;
+					}
+					if (same) return Match { k.length, k.id };
+				}
+				return { };
+			}
+		};
+	}
+
+	// `sor` of many literal alternatives (`TAO_PEGTL_STRING(...)`, `TAO_PEGTL_ISTRING(...)`,
+	// mixed as needed) matched without trying them one by one: a table built at compile time
+	// maps the first byte to the few keywords that can start with it, which are compared
+	// 8 bytes at a time, so the cost no longer grows with the number of keywords.
+	// Unlike `sor`, the longest keyword wins (`"in"` does not hide `"int"`); of equally long
+	// ones, the first listed. `id(text)` tells which one `text` is, see `PushKeyword`.
+	template < class... Keywords >
+	struct keywords
+	{
+		using rule_t = keywords;
+		using subs_t = tao::pegtl::empty_list;
+		using Table = detail::KeywordTable< Keywords... >;
+
+		// Position of `text` in `Keywords...`, or -1 if it is not one of them.
+		static int id(std::string_view text)
+		{
+			const auto m = Table::longest(text.data(), text.size());
+			return m.length == text.size() ? m.id : -1;
+		}
+
+		template < class ParseInput >
+		static bool match(ParseInput& in)
+		{
+			const auto m = Table::longest(in.current(), in.size(Table::max_length));
+			if (m.id < 0) return false;
+			if constexpr (Table::contains(ParseInput::eol_t::ch)) in.bump(m.length);
+			else in.bump_in_this_line(m.length);
+			return true;
+		}
+	};
+
+	// Action for a rule derived from `keywords<>`: pushes the id of the keyword that matched
+	// (an `int`) into the consumer, e.g. a `Degenerator< R, const int >`.
+	template < class Keywords >
+	struct PushKeyword
+	{
+		template < class ActionInput, class Coro >
+		static void apply(const ActionInput& in, Coro& coro)
+		{
+			int id = Keywords::id(in.string_view());
+			coro.push_value(id);
+		}
+	};
+
+	namespace detail
+	{
+		template < class... Keywords >
+		struct FirstOf< keywords< Keywords... > >
+		{
+			static constexpr FirstSet value = []
+			{
+				FirstSet f;
+				for (std::size_t c = 0; c < 256; ++c) f.bytes[c] = KeywordTable< Keywords... >::tables.bucket[c] != KeywordTable< Keywords... >::tables.bucket[c + 1];
+				return f;
+			}();
+		};
+	}
+}
+
+namespace TAO_PEGTL_NAMESPACE
+{
+	template < typename Name, typename... Rules >
+	struct analyze_traits< Name, coroparse::dispatch_sor< Rules... > >
+		: analyze_sor_traits< Rules... >
+	{ };
+
+	template < typename Name, typename... Keywords >
+	struct analyze_traits< Name, coroparse::keywords< Keywords... > >
+		: analyze_any_traits<>
+	{ };
+}
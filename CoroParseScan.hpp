@@ -0,0 +1,462 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+#if !defined(COROPARSE_NO_SIMD)
+#if defined(__AVX2__)
+#define COROPARSE_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COROPARSE_SSE2 1
+#endif
+#endif
+#if defined(COROPARSE_AVX2) || defined(COROPARSE_SSE2)
+#include <immintrin.h>
+#endif
+
+#include <tao/pegtl/contrib/analyze_traits.hpp>
+
+#include "CoroParse.hpp"
+
+namespace coroparse
+{
+	// Compile-time set of bytes, e.g. `CharSet< '"', '\\' >`.
+	template < char... Cs >
+	struct CharSet
+	{
+		static constexpr std::array< char, sizeof...(Cs) > chars { Cs... };
+
+		static constexpr bool contains(char c) { return ((c == Cs) || ...); }
+	};
+
+	namespace detail
+	{
+		template < std::size_t N >
+		const char* find_first_of_scalar(const char* p, const char* end, const std::array< char, N >& set)
+		{
+			for (; p != end; ++p)
+				for (char c : set)
+					if (*p == c) return p;
+			return end;
+		}
+	}
+
+	// First byte of [p, end) that is one of `set`, or `end`. Compares 32 bytes at a time with
+	// AVX2, 16 with SSE2 (always there on x86-64), one at a time elsewhere; the instruction set
+	// is picked at compile time, build with `-mavx2` (or `COROPARSE_NATIVE`) for the wide one.
+	// `COROPARSE_NO_SIMD` forces the scalar loop.
+	template < std::size_t N >
+	const char* find_first_of(const char* p, const char* end, const std::array< char, N >& set)
+	{
+		static_assert(N > 0);
+#if defined(COROPARSE_AVX2)
+		if (end - p >= 32)
+		{
+			__m256i needles[N];
+			for (std::size_t i = 0; i < N; ++i) needles[i] = _mm256_set1_epi8(set[i]);
+			for (; end - p >= 32; p += 32)
+			{
+				const __m256i block = _mm256_loadu_si256(reinterpret_cast< const __m256i* >(p));
+				__m256i hits = _mm256_cmpeq_epi8(block, needles[0]);
+				for (std::size_t i = 1; i < N; ++i) hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, needles[i]));
+				if (const auto mask = static_cast< std::uint32_t >(_mm256_movemask_epi8(hits))) return p + std::countr_zero(mask);
+			}
+		}
+#endif
+#if defined(COROPARSE_SSE2)
+		if (end - p >= 16)
+		{
+			__m128i needles[N];
+			for (std::size_t i = 0; i < N; ++i) needles[i] = _mm_set1_epi8(set[i]);
+			for (; end - p >= 16; p += 16)
+			{
+				const __m128i block = _mm_loadu_si128(reinterpret_cast< const __m128i* >(p));
+				__m128i hits = _mm_cmpeq_epi8(block, needles[0]);
+				for (std::size_t i = 1; i < N; ++i) hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, needles[i]));
+				if (const auto mask = static_cast< std::uint32_t >(_mm_movemask_epi8(hits))) return p + std::countr_zero(mask);
+			}
+		}
+#endif
+		return detail::find_first_of_scalar(p, end, set);
+	}
+
+	template < class Set >
+	const char* find_first_of(const char* p, const char* end)
+	{
+		return find_first_of(p, end, Set::chars);
+	}
+
+	// Lexical syntax for `scan_tokens()`. JSON by default; `ex::Error` would be
+	// `ScanSyntax< CharSet< '[', ']', ',' >, CharSet< '"', '\'' >, 0 >`.
+	template < class Structural = CharSet< '{', '}', '[', ']', ',', ':' >, class Quotes = CharSet< '"' >, char Escape = '\\' >
+	struct ScanSyntax
+	{
+		using structural = Structural;
+		using quotes = Quotes;
+		static constexpr char escape = Escape;
+	};
+
+	// Tokenizes `text` with vector scans instead of per-byte rule dispatch and hands the tokens
+	// to `coro` in batches (one resume per batch for a consumer on `NextTokens`). The tokens are
+	// views into `text`:
+	// - every structural character on its own (`{`, `,`, ...);
+	// - every quoted string, quotes included and escapes left as they are;
+	// - every other run between those, with the white space around it trimmed (numbers,
+	//   `true`, identifiers, ...).
+	// This is a lexer, not a validator: `[1 2}` gives `[`, `1 2`, `}`. The consumer (or a PEGTL
+	// parse of the pieces it cares about) decides what is well-formed. Returns false if a
+	// string is not terminated; the tokens before it have been delivered.
+	template < class Syntax = ScanSyntax<>, class Coro >
+	bool scan_tokens(std::string_view text, Coro& coro)
+	{
+		constexpr auto stops = []
+		{
+			constexpr auto& s = Syntax::structural::chars;
+			constexpr auto& q = Syntax::quotes::chars;
+			std::array< char, s.size() + q.size() > all { };
+			for (std::size_t i = 0; i < s.size(); ++i) all[i] = s[i];
+			for (std::size_t i = 0; i < q.size(); ++i) all[s.size() + i] = q[i];
+			return all;
+		}();
+		const auto is_space = [](char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; };
+
+		std::array< std::string_view, 256 > batch;
+		std::size_t count = 0;
+		const auto emit = [&](const char* b, const char* e)
+		{
+			batch[count++] = std::string_view(b, static_cast< std::size_t >(e - b));
+			if (count == batch.size())
+			{
+				deliver_tokens(coro, std::span< const std::string_view >(batch.data(), count));
+				count = 0;
+			}
+		};
+		const auto flush = [&] { deliver_tokens(coro, std::span< const std::string_view >(batch.data(), count)); };
+
+		const char* p = text.data();
+		const char* const end = p + text.size();
+		while (p != end)
+		{
+			const char* stop = find_first_of(p, end, stops);
+
+			// The run before the stop, trimmed. Runs are short, a scalar trim is fine.
+			const char* b = p;
+			const char* e = stop;
+			while (b != e && is_space(*b)) ++b;
+			while (e != b && is_space(e[-1])) --e;
+			if (b != e) emit(b, e);
+			if (stop == end) break;
+
+			if (Syntax::quotes::contains(*stop))
+			{
+				// Inside the string only the closing quote and the escape matter.
+				const char quote = *stop;
+				const std::array< char, 2 > inner { quote, Syntax::escape ? Syntax::escape : quote };
+				const char* q = stop + 1;
+				while (true)
+				{
+					q = find_first_of(q, end, inner);
+					if (q == end)
+					{
+						flush();
+						return false;
+					}
+					if (*q == quote) break;
+					q = end - q >= 2 ? q + 2 : end; // Escape and the escaped byte.
+				}
+				emit(stop, q + 1);
+				p = q + 1;
+			}
+			else
+			{
+				emit(stop, stop + 1);
+				p = stop + 1;
+			}
+		}
+		flush();
+		return true;
+	}
+
+	namespace detail
+	{
+		// Union of single-byte PEGTL character classes (`one`, `not_one`, `ranges`, `alpha`,
+		// `space`, ...) as a 256-entry table. Runs of the class are scanned with
+		// `find_first_of()` when at most 8 byte values are outside of it (`not_one< '"', '\\' >`,
+		// say), otherwise with the table.
+		template < class... Classes >
+		struct ClassTable
+		{
+			static_assert((std::is_same_v< typename Classes::rule_t::peek_t, tao::pegtl::internal::peek_char > && ...),
+				"Only single-byte character classes can be scanned with a table.");
+
+			static constexpr bool test(char c) { return (Classes::rule_t::test(c) || ...); }
+
+			static constexpr std::array< bool, 256 > table = []
+			{
+				std::array< bool, 256 > t { };
+				for (std::size_t i = 0; i < 256; ++i) t[i] = test(static_cast< char >(i));
+				return t;
+			}();
+			static constexpr std::size_t outside = []
+			{
+				std::size_t n = 0;
+				for (bool in : table) n += in ? 0 : 1;
+				return n;
+			}();
+			static constexpr std::size_t max_stops = 8;
+			static constexpr auto stops = []
+			{
+				std::array< char, (outside > 0 && outside <= max_stops) ? outside : 1 > s { };
+				std::size_t n = 0;
+				for (std::size_t i = 0; i < 256 && n < s.size(); ++i)
+					if (!table[i]) s[n++] = static_cast< char >(i);
+				return s;
+			}();
+
+			// End of the run of class bytes starting at `p`.
+			static const char* scan(const char* p, const char* end)
+			{
+				if constexpr (outside == 0) return end;
+				else if constexpr (outside <= max_stops) return find_first_of(p, end, stops);
+				else
+				{
+					while (end - p >= 4)
+					{
+						if (!table[static_cast< unsigned char >(p[0])]) return p;
+						if (!table[static_cast< unsigned char >(p[1])]) return p + 1;
+						if (!table[static_cast< unsigned char >(p[2])]) return p + 2;
+						if (!table[static_cast< unsigned char >(p[3])]) return p + 3;
+						p += 4;
+					}
+					while (p != end && table[static_cast< unsigned char >(*p)]) ++p;
+					return p;
+				}
+			}
+		};
+
+		// `in.bump(n)` counts the lines of the `n` bytes at `p` one byte at a time; this finds
+		// the line ends with a vector search instead.
+		template < class ParseInput >
+		void bump_lines(ParseInput& in, const char* p, std::size_t n)
+		{
+			if constexpr (requires { in.bump_to_next_line(1); })
+			{
+				const std::array< char, 1 > eol { static_cast< char >(ParseInput::eol_t::ch) };
+				const char* const end = p + n;
+				while (true)
+				{
+					const char* q = find_first_of(p, end, eol);
+					in.bump_in_this_line(static_cast< std::size_t >(q - p));
+					if (q == end) return;
+					in.bump_to_next_line(1);
+					p = q + 1;
+				}
+			}
+			else in.bump(n);
+		}
+
+		template < std::size_t Min, class... Classes >
+		struct ClassRun
+		{
+			using rule_t = ClassRun;
+			using subs_t = tao::pegtl::empty_list;
+			using Table = ClassTable< Classes... >;
+
+			template < class ParseInput >
+			static bool match(ParseInput& in)
+			{
+				std::size_t total = 0;
+				while (true)
+				{
+					// Everything for in-memory inputs; for buffer inputs what is buffered, refilled
+					// only once it is used up (asking for more could overrun a small buffer).
+					const std::size_t available = in.size(1);
+					if (available == 0) break;
+					const char* p = in.current();
+					const auto n = static_cast< std::size_t >(Table::scan(p, p + available) - p);
+					if constexpr (Table::test(ParseInput::eol_t::ch)) bump_lines(in, p, n);
+					else in.bump_in_this_line(n);
+					total += n;
+					if (n < available) break;
+				}
+				return total >= Min;
+			}
+		};
+	}
+
+	namespace detail
+	{
+		// State of a scan for the end of a balanced structure, carried from one block (and one
+		// buffer fill) to the next. Each block of the input is compared with the four bytes at
+		// once into bit masks; only the set bits are looked at one by one, and a block without
+		// quotes whose closing brackets cannot take the depth to zero is done with two popcounts.
+		template < char Open, char Close, char Quote, char Escape >
+		class BalancedScan
+		{
+		public:
+			// Past the `Close` that balances the first `Open`, or `end` if it is not in [p, end).
+			const char* run(const char* p, const char* end)
+			{
+#if defined(COROPARSE_AVX2)
+				if (end - p >= 32)
+				{
+					const __m256i open = _mm256_set1_epi8(Open), close = _mm256_set1_epi8(Close), quote = _mm256_set1_epi8(Quote), escape = _mm256_set1_epi8(Escape);
+					for (; end - p >= 32; p += 32)
+					{
+						const __m256i block = _mm256_loadu_si256(reinterpret_cast< const __m256i* >(p));
+						const auto mask = [&block](__m256i c) { return static_cast< std::uint32_t >(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, c))); };
+						if (const int n = step(mask(open), mask(close), Quote ? mask(quote) : 0, Escape ? mask(escape) : 0, 32); n >= 0) return p + n;
+					}
+				}
+#endif
+#if defined(COROPARSE_SSE2)
+				if (end - p >= 16)
+				{
+					const __m128i open = _mm_set1_epi8(Open), close = _mm_set1_epi8(Close), quote = _mm_set1_epi8(Quote), escape = _mm_set1_epi8(Escape);
+					for (; end - p >= 16; p += 16)
+					{
+						const __m128i block = _mm_loadu_si128(reinterpret_cast< const __m128i* >(p));
+						const auto mask = [&block](__m128i c) { return static_cast< std::uint32_t >(_mm_movemask_epi8(_mm_cmpeq_epi8(block, c))); };
+						if (const int n = step(mask(open), mask(close), Quote ? mask(quote) : 0, Escape ? mask(escape) : 0, 16); n >= 0) return p + n;
+					}
+				}
+#endif
+				while (p != end)
+				{
+					const auto width = static_cast< unsigned >(end - p < 32 ? end - p : 32);
+					std::uint32_t o = 0, c = 0, q = 0, e = 0;
+					for (unsigned i = 0; i < width; ++i)
+					{
+						o |= std::uint32_t(p[i] == Open) << i;
+						c |= std::uint32_t(p[i] == Close) << i;
+						q |= std::uint32_t(Quote && p[i] == Quote) << i;
+						e |= std::uint32_t(Escape && p[i] == Escape) << i;
+					}
+					if (const int n = step(o, c, q, e, width); n >= 0) return p + n;
+					p += width;
+				}
+				return end;
+			}
+
+			bool done() const { return closed; }
+
+		private:
+			// Offset past the balancing `Close` in a block of `width` bytes, or -1.
+			int step(std::uint32_t o, std::uint32_t c, std::uint32_t q, std::uint32_t e, unsigned width)
+			{
+				std::uint32_t bits = o | c | q | e;
+				if (escaped)
+				{
+					bits &= ~std::uint32_t(1); // Escaped at the end of the last block.
+					escaped = false;
+				}
+				if (!in_string && (bits & q) == 0 && depth > static_cast< std::size_t >(std::popcount(c)))
+				{
+					depth += static_cast< std::size_t >(std::popcount(o)) - static_cast< std::size_t >(std::popcount(c));
+					return -1;
+				}
+				while (bits)
+				{
+					const int i = std::countr_zero(bits);
+					const std::uint32_t bit = std::uint32_t(1) << i;
+					bits &= bits - 1;
+					if (in_string)
+					{
+						if (e & bit)
+						{
+							if (static_cast< unsigned >(i) + 1 < width) bits &= ~(bit << 1);
+							else escaped = true;
+						}
+						else if (q & bit) in_string = false;
+					}
+					else if (q & bit) in_string = true;
+					else if (o & bit) ++depth;
+					else if ((c & bit) && --depth == 0)
+					{
+						closed = true;
+						return i + 1;
+					}
+				}
+				return -1;
+			}
+
+			std::size_t depth = 0;
+			bool in_string = false;
+			bool escaped = false;
+			bool closed = false;
+		};
+	}
+
+	// End of the balanced structure that starts with the `Open` at `p` (past its `Close`), or
+	// nullptr if it does not close before `end`. See `skip_balanced`.
+	template < char Open, char Close, char Quote = '"', char Escape = '\\' >
+	const char* find_balanced_end(const char* p, const char* end)
+	{
+		detail::BalancedScan< Open, Close, Quote, Escape > scan;
+		const char* const q = scan.run(p, end);
+		return scan.done() ? q : nullptr;
+	}
+
+	// Skips a nested structure from an `Open` to the `Close` that balances it, e.g.
+	// `skip_balanced< '{', '}' >` for a JSON object, without a rule match per byte: one vector
+	// scan for the four bytes (see `detail::BalancedScan`) and one bump. Brackets inside
+	// `Quote`-delimited strings do not count, `Escape` inside them escapes the next byte; 0
+	// turns either off. Nothing else is checked: `{ ] x }` is skipped like `{}`, and only
+	// `Open`/`Close` are counted, which is enough to find the end of any well-formed value.
+	// Fails if the input does not start with `Open` or ends before the structure does.
+	template < char Open, char Close, char Quote = '"', char Escape = '\\' >
+	struct skip_balanced
+	{
+		static_assert(Open != Close && Open != Quote && Close != Quote && Open && Close);
+
+		using rule_t = skip_balanced;
+		using subs_t = tao::pegtl::empty_list;
+
+		template < tao::pegtl::apply_mode A, tao::pegtl::rewind_mode M, template< class... > class Action, template< class... > class Control, class ParseInput, class... States >
+		static bool match(ParseInput& in, States&&... /*unused*/)
+		{
+			if (in.empty() || in.peek_char() != Open) return false;
+			auto m = in.template mark< M >();
+			detail::BalancedScan< Open, Close, Quote, Escape > scan;
+			while (true)
+			{
+				// Everything for in-memory inputs; for buffer inputs what is buffered, refilled
+				// once it is used up.
+				const std::size_t available = in.size(1);
+				if (available == 0) return m(false);
+				const char* p = in.current();
+				const char* q = scan.run(p, p + available);
+				detail::bump_lines(in, p, static_cast< std::size_t >(q - p));
+				if (scan.done()) return m(true);
+			}
+		}
+	};
+
+	// `star< sor< Classes... > >` for single-byte character classes, e.g.
+	// `star_class< alnum, space >`: the run is scanned in one go (table or vector search, see
+	// `detail::ClassTable`) and the input bumped once, instead of a `match` per byte.
+	// Attach actions to a rule derived from it to receive the whole run.
+	template < class... Classes >
+	struct star_class : detail::ClassRun< 0, Classes... > { };
+
+	// `plus< sor< Classes... > >`, see `star_class`.
+	template < class... Classes >
+	struct plus_class : detail::ClassRun< 1, Classes... > { };
+}
+
+namespace TAO_PEGTL_NAMESPACE
+{
+	template < typename Name, std::size_t Min, typename... Classes >
+	struct analyze_traits< Name, coroparse::detail::ClassRun< Min, Classes... > >
+		: std::conditional_t< Min == 0, analyze_opt_traits<>, analyze_any_traits<> >
+	{ };
+
+	template < typename Name, char Open, char Close, char Quote, char Escape >
+	struct analyze_traits< Name, coroparse::skip_balanced< Open, Close, Quote, Escape > > : analyze_any_traits<> { };
+}
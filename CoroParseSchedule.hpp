@@ -0,0 +1,426 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "CoroParse.hpp"
+
+namespace coroparse
+{
+	// Run queue multiplexing many Degenerator sessions (e.g. one per client stream) on one
+	// thread. Tokens are posted to a session's inbox and the session is put on the ready list;
+	// `run()` resumes ready sessions round-robin, handing each at most `batch` tokens per turn
+	// (as one span for consumers on `NextTokens`) so that a chatty stream cannot starve the others.
+	// Posted tokens are stored by value: views must point at bytes that outlive their delivery.
+	// Sessions interleave, so their frames are not LIFO with respect to each other; give each
+	// session its own FrameArena (or none) rather than sharing one across sessions.
+	template < class R, class T >
+	class Scheduler
+	{
+	public:
+		// Slot of the session in the low 32 bits, the slot's generation in the high ones: the id
+		// of a finished session never names the session that reuses its slot.
+		using Id = std::uint64_t;
+		using Parser = Degenerator< R, T >;
+		// Called once per session, after its input was closed and drained or it rejected its input.
+		using Completion = std::function< void(Id, Expected< R >) >;
+
+		explicit Scheduler(Completion on_done_, std::size_t batch_ = 64) : on_done { std::move(on_done_) }, batch { batch_ } { }
+
+		Id spawn(Parser parser)
+		{
+			std::size_t slot;
+			if (free_slots.empty())
+			{
+				slot = sessions.size();
+				sessions.emplace_back();
+				generations.push_back(0);
+			}
+			else
+			{
+				slot = free_slots.back();
+				free_slots.pop_back();
+			}
+			sessions[slot].emplace(std::move(parser));
+			++live;
+			return (Id(generations[slot]) << 32) | slot;
+		}
+
+		// Tokens posted to a session that finished already are dropped.
+		void post(Id id, std::remove_const_t< T > value)
+		{
+			Session* s = find(id);
+			if (!s) return;
+			assert(!s->closed && "Token posted after close().");
+			s->inbox.push_back(std::move(value));
+			make_ready(id);
+		}
+		// End of input for the session: it completes once its inbox is drained. Does nothing if
+		// it finished already.
+		void close(Id id)
+		{
+			Session* s = find(id);
+			if (!s) return;
+			s->closed = true;
+			make_ready(id);
+		}
+
+		// One pass over the sessions that were ready when it started. Returns whether any
+		// session is still ready.
+		bool run_once()
+		{
+			for (std::size_t n = ready.size(); n > 0; --n)
+			{
+				const Id id = ready.front();
+				ready.pop_front();
+				Session& s = *find(id);
+				s.queued = false;
+
+				const std::size_t count = std::min(batch, s.inbox.size() - s.head);
+				if (count > 0 && !s.parser.done())
+				{
+					s.parser.push_values(std::span< T >(s.inbox.data() + s.head, count));
+					s.head += count;
+				}
+				if (s.head == s.inbox.size())
+				{
+					s.inbox.clear();
+					s.head = 0;
+				}
+
+				if (s.parser.done() || (s.closed && s.head == s.inbox.size())) complete(id);
+				else if (s.head < s.inbox.size()) make_ready(id);
+			}
+			return !ready.empty();
+		}
+		// Runs until no session has work left.
+		void run()
+		{
+			while (run_once()) { }
+		}
+
+		bool is_ready(Id id) const
+		{
+			const Session* s = find(id);
+			return s && s->queued;
+		}
+		std::size_t ready_count() const { return ready.size(); }
+		std::size_t session_count() const { return live; }
+
+	private:
+		struct Session
+		{
+			explicit Session(Parser&& parser_) : parser { std::move(parser_) } { }
+
+			Parser parser;
+			std::vector< std::remove_const_t< T > > inbox;
+			std::size_t head = 0; // Tokens before it were delivered.
+			bool closed = false;
+			bool queued = false;
+		};
+
+		// The live session `id` names, or nullptr.
+		Session* find(Id id)
+		{
+			const auto slot = static_cast< std::size_t >(id & 0xFFFFFFFF);
+			if (slot >= sessions.size() || generations[slot] != static_cast< std::uint32_t >(id >> 32) || !sessions[slot]) return nullptr;
+			return std::addressof(*sessions[slot]);
+		}
+		const Session* find(Id id) const { return const_cast< Scheduler* >(this)->find(id); }
+
+		void make_ready(Id id)
+		{
+			Session& s = *find(id);
+			if (s.queued) return;
+			s.queued = true;
+			ready.push_back(id);
+		}
+
+		void complete(Id id)
+		{
+			const auto slot = static_cast< std::size_t >(id & 0xFFFFFFFF);
+			Expected< R > result = sessions[slot]->parser.try_result();
+			sessions[slot].reset();
+			++generations[slot];
+			free_slots.push_back(slot);
+			--live;
+			if (on_done) on_done(id, std::move(result));
+		}
+
+		Completion on_done;
+		std::size_t batch;
+		std::vector< std::optional< Session > > sessions;
+		std::vector< std::uint32_t > generations; // Bumped when the slot's session finishes.
+		std::vector< std::size_t > free_slots;
+		std::deque< Id > ready;
+		std::size_t live = 0;
+	};
+
+	// Work-stealing thread pool. Every worker owns a deque: tasks submitted from a worker go to
+	// the back of its own deque and are popped from there again (newest first, while their data
+	// is still in cache); tasks submitted from other threads are dealt round-robin. A worker that
+	// runs dry steals the oldest task of another worker before going to sleep.
+	// Tasks must not throw.
+	class Executor
+	{
+	public:
+		using Task = std::function< void() >;
+
+		explicit Executor(std::size_t worker_count = std::max(1u, std::thread::hardware_concurrency()))
+		{
+			assert(worker_count > 0);
+			for (std::size_t i = 0; i < worker_count; ++i) workers.push_back(std::make_unique< Worker >());
+			threads.reserve(worker_count);
+			for (std::size_t i = 0; i < worker_count; ++i) threads.emplace_back([this, i] { work(i); });
+		}
+		Executor(const Executor&) = delete;
+		Executor& operator=(const Executor&) = delete;
+		// Runs every submitted task before the workers are stopped.
+		~Executor()
+		{
+			wait();
+			stopping = true;
+			wakeups.fetch_add(1);
+			wakeups.notify_all();
+			for (std::thread& t : threads) t.join();
+		}
+
+		void submit(Task task)
+		{
+			const std::size_t target = current_executor == this
+				? current_worker
+				: next_worker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+			pending.fetch_add(1);
+			{
+				std::lock_guard< std::mutex > lock { workers[target]->mutex };
+				workers[target]->tasks.push_back(std::move(task));
+			}
+			wakeups.fetch_add(1);
+			wakeups.notify_one();
+		}
+		// Blocks until every task submitted so far, and every task those submitted, has run.
+		// Not to be called from a task.
+		void wait()
+		{
+			assert(current_executor != this && "Executor::wait() called from one of its own tasks.");
+			while (const std::size_t n = pending.load()) pending.wait(n);
+		}
+
+		std::size_t worker_count() const { return workers.size(); }
+		// Tasks run by another worker than the one they were queued on.
+		std::size_t steal_count() const { return steals.load(std::memory_order_relaxed); }
+
+	private:
+		struct Worker
+		{
+			std::mutex mutex;
+			std::deque< Task > tasks;
+		};
+		// The executor and worker the calling thread belongs to, if any.
+		static inline thread_local const Executor* current_executor = nullptr;
+		static inline thread_local std::size_t current_worker = 0;
+
+		bool pop(std::size_t self, Task& task)
+		{
+			Worker& w = *workers[self];
+			std::lock_guard< std::mutex > lock { w.mutex };
+			if (w.tasks.empty()) return false;
+			task = std::move(w.tasks.back());
+			w.tasks.pop_back();
+			return true;
+		}
+		bool steal(std::size_t self, Task& task)
+		{
+			for (std::size_t i = 1; i < workers.size(); ++i)
+			{
+				Worker& victim = *workers[(self + i) % workers.size()];
+				std::lock_guard< std::mutex > lock { victim.mutex };
+				if (victim.tasks.empty()) continue;
+				task = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				steals.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+			return false;
+		}
+
+		void work(std::size_t self)
+		{
+			current_executor = this;
+			current_worker = self;
+			Task task;
+			while (true)
+			{
+				// Read before looking for work: a task submitted after the search failed bumps
+				// it, so the wait below cannot miss that task.
+				const std::uint32_t seen = wakeups.load();
+				if (pop(self, task) || steal(self, task))
+				{
+					task();
+					task = nullptr;
+					if (pending.fetch_sub(1) == 1) pending.notify_all();
+					continue;
+				}
+				if (stopping) return;
+				wakeups.wait(seen);
+			}
+		}
+
+		std::vector< std::unique_ptr< Worker > > workers;
+		std::vector< std::thread > threads;
+		std::atomic< std::size_t > next_worker { 0 };
+		std::atomic< std::size_t > pending { 0 }; // Submitted and not finished yet.
+		std::atomic< std::size_t > steals { 0 };
+		// Idle workers sleep on it (C++20 atomic wait) until a task is submitted.
+		std::atomic< std::uint32_t > wakeups { 0 };
+		std::atomic< bool > stopping { false };
+	};
+
+	// How a ParallelSession talks to the parser it drives.
+	template < class Parser >
+	struct SessionTraits;
+
+	template < class R, class T >
+	struct SessionTraits< Degenerator< R, T > >
+	{
+		using Result = R;
+		using Token = std::remove_const_t< T >;
+
+		static void push(Degenerator< R, T >& parser, std::span< Token > tokens) { parser.push_values(std::span< T >(tokens)); }
+	};
+
+	template < class T >
+	struct SessionTraits< ParserProc< T > >
+	{
+		using Result = T;
+		using Token = std::string_view;
+
+		static void push(ParserProc< T >& parser, std::span< Token > tokens)
+		{
+			for (std::string_view tk : tokens)
+			{
+				if (parser.done()) return;
+				parser.push_token(tk);
+			}
+		}
+	};
+
+	// A parse session fed from any thread and resumed on the workers of an Executor: the
+	// multi-core counterpart of a Scheduler session. At most one turn of a session is queued or
+	// running at any time, so its coroutine frames are only ever resumed by one worker at a
+	// time and need no locking; between turns (every `batch` tokens) an idle worker may steal
+	// the session. Create sessions with `spawn_session()`.
+	// As with Scheduler, posted tokens are stored by value and sessions should not share a
+	// FrameArena: each one may be running on a different thread.
+	template < class Parser >
+	class ParallelSession : public std::enable_shared_from_this< ParallelSession< Parser > >
+	{
+	public:
+		using Result = typename SessionTraits< Parser >::Result;
+		using Token = typename SessionTraits< Parser >::Token;
+		// Called once, on a worker thread, after the input was closed and drained or the parser
+		// stopped asking for tokens.
+		using Completion = std::function< void(Expected< Result >) >;
+
+		ParallelSession(Executor& executor_, Parser parser_, Completion on_done_, std::size_t batch_)
+			: executor { executor_ }, parser { std::move(parser_) }, on_done { std::move(on_done_) }, batch { batch_ } { }
+
+		// Tokens posted after the parser finished are dropped.
+		void post(Token value)
+		{
+			std::unique_lock< std::mutex > lock { mutex };
+			assert(!closed && "Token posted after close().");
+			if (completed) return;
+			inbox.push_back(std::move(value));
+			schedule(lock);
+		}
+		// End of input: the session completes once its inbox is drained.
+		void close()
+		{
+			std::unique_lock< std::mutex > lock { mutex };
+			closed = true;
+			if (!completed) schedule(lock);
+		}
+
+	private:
+		// Queues a turn unless one is queued or running already; that one will pick up the new work.
+		void schedule(std::unique_lock< std::mutex >& lock)
+		{
+			if (scheduled) return;
+			scheduled = true;
+			lock.unlock();
+			executor.submit([self = this->shared_from_this()] { self->turn(); });
+		}
+
+		void turn()
+		{
+			{
+				std::lock_guard< std::mutex > lock { mutex };
+				const std::size_t count = std::min(batch, inbox.size() - head);
+				delivering.assign(std::make_move_iterator(inbox.begin() + head), std::make_move_iterator(inbox.begin() + head + count));
+				head += count;
+				if (head == inbox.size())
+				{
+					inbox.clear();
+					head = 0;
+				}
+			}
+
+			if (!delivering.empty()) SessionTraits< Parser >::push(parser, std::span< Token >(delivering));
+			const bool parser_done = parser.done();
+
+			std::unique_lock< std::mutex > lock { mutex };
+			if (parser_done || (closed && head == inbox.size()))
+			{
+				completed = true;
+				scheduled = false;
+				inbox.clear();
+				lock.unlock();
+				Expected< Result > result = parser.try_result();
+				if (on_done) on_done(std::move(result));
+			}
+			else if (head < inbox.size())
+			{
+				// Requeued on this worker: the frames stay in its cache unless somebody steals them.
+				lock.unlock();
+				executor.submit([self = this->shared_from_this()] { self->turn(); });
+			}
+			else scheduled = false;
+		}
+
+		Executor& executor;
+		Parser parser;                    // Only touched by the turn in flight.
+		std::vector< Token > delivering;  // Likewise.
+		Completion on_done;
+		std::size_t batch;
+
+		std::mutex mutex;
+		std::vector< Token > inbox;
+		std::size_t head = 0; // Tokens before it were delivered.
+		bool closed = false;
+		bool scheduled = false;
+		bool completed = false;
+	};
+
+	// `auto s = spawn_session(executor, parser(), on_done);` then `s->post(token)` from any
+	// thread and `s->close()` at the end of the input.
+	template < class Parser >
+	std::shared_ptr< ParallelSession< Parser > > spawn_session(Executor& executor, Parser parser,
+		typename ParallelSession< Parser >::Completion on_done, std::size_t batch = 64)
+	{
+		return std::make_shared< ParallelSession< Parser > >(executor, std::move(parser), std::move(on_done), batch);
+	}
+}
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#if __has_include(<unistd.h>)
+#include <unistd.h>
+#endif
+#if __has_include(<ucontext.h>)
+#include <ucontext.h>
+#define COROPARSE_HAS_UCONTEXT 1
+#endif
+
+#if defined(__SANITIZE_ADDRESS__)
+#define COROPARSE_ASAN 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define COROPARSE_ASAN 1
+#endif
+#endif
+#if defined(COROPARSE_ASAN)
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+#include "CoroParse.hpp"
+
+namespace coroparse
+{
+	// Grammar for a stream of independent `Rule`s. The input consumed by each item is discarded
+	// once it matched, so the buffer only ever holds the item being parsed plus read-ahead.
+	// Grammars with a single huge top-level item should place `tao::pegtl::discard` at safe
+	// points themselves (after each element of a list, etc.).
+	template < class Rule >
+	struct StreamOf : tao::pegtl::seq< tao::pegtl::star< Rule, tao::pegtl::discard >, tao::pegtl::eof > { };
+
+	// Readers for `tao::pegtl::buffer_input`. Like PEGTL's own readers, they fill `length` bytes
+	// unless the end of the stream is reached first; returning 0 means end of stream.
+	struct FileReader
+	{
+		explicit FileReader(std::FILE* file_) : file { file_ } { assert(file); }
+
+		std::size_t operator()(char* buffer, std::size_t length) const
+		{
+			const std::size_t r = std::fread(buffer, 1, length, file);
+			if (r == 0 && std::ferror(file)) fail("std::fread() failed", errno);
+			return r;
+		}
+
+		std::FILE* file;
+
+		[[noreturn]] static void fail(const char* what, int ec)
+		{
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+			throw std::system_error(ec, std::system_category(), what);
+#else
+			std::fprintf(stderr, "coroparse: %s (%d)\n", what, ec);
+			std::abort();
+#endif
+		}
+	};
+
+#if __has_include(<unistd.h>)
+	// File descriptors: regular files, pipes and sockets. Blocks until `length` bytes arrived.
+	struct FdReader
+	{
+		explicit FdReader(int fd_) : fd { fd_ } { }
+
+		std::size_t operator()(char* buffer, std::size_t length) const
+		{
+			std::size_t filled = 0;
+			while (filled < length)
+			{
+				const ::ssize_t r = ::read(fd, buffer + filled, length - filled);
+				if (r > 0) filled += static_cast< std::size_t >(r);
+				else if (r == 0) break;
+				else if (errno != EINTR) FileReader::fail("read() failed", errno);
+			}
+			return filled;
+		}
+
+		int fd;
+	};
+#endif
+
+	// Parses `StreamOf< Rule >` from `reader` through a buffer of at most `buffer_size` bytes
+	// (plus `Chunk` bytes of read-ahead), pushing tokens into `coro`. The input is pulled in
+	// `Chunk`-sized reads; between them the consumer coroutine simply stays suspended on its
+	// `co_await NextToken`. `buffer_size` bounds the longest item, not the stream.
+	// Tokens delivered through `PushToken` point into the buffer: they are only valid until the
+	// consumer suspends again, copy what must outlive that.
+	template < class Rule, template< class... > class Action = tao::pegtl::nothing, std::size_t Chunk = 4096, class Reader, class Coro >
+	bool parse_stream(Reader&& reader, Coro& coro, std::size_t buffer_size = 64 * 1024, std::string source = "stream")
+	{
+		tao::pegtl::buffer_input< std::decay_t< Reader >, tao::pegtl::eol::lf_crlf, std::string, Chunk > in(std::move(source), buffer_size, std::forward< Reader >(reader));
+		return tao::pegtl::parse< StreamOf< Rule >, Action >(in, coro);
+	}
+
+	enum class ParseStatus
+	{
+		NeedMoreInput, // Suspended inside the grammar until more bytes are fed.
+		Success,
+		Failure,
+	};
+
+#if defined(COROPARSE_HAS_UCONTEXT)
+	// A PEGTL parse that can be suspended and resumed when its input runs dry, e.g. one per
+	// network connection, all driven from one thread. PEGTL is recursive descent on the C
+	// stack, so the parse runs on a small stack of its own (`stack_size` bytes) and switches
+	// back to the caller from inside `buffer_input::require()` once the bytes handed to `feed()`
+	// are used up. The caller's bytes are copied into the parser's bounded buffer as needed, so
+	// they only have to stay alive for the duration of `feed()`.
+	// The parse sees exactly the input a whole-buffer parse would: a rule never observes a
+	// partial read, `require()` only returns once it has the bytes it asked for or the input
+	// was `finish()`ed.
+	// Each `feed()` costs two context switches (glibc's swapcontext includes a sigprocmask
+	// system call), so feed reasonably sized pieces. Not available where <ucontext.h> is not.
+	template < class Rule, template< class... > class Action, class Coro >
+	class IncrementalParse
+	{
+	public:
+		IncrementalParse(Coro& coro_, std::size_t buffer_size, std::size_t stack_size)
+			: coro { coro_ },
+			  stack { new char[stack_size] },
+			  stack_bytes { stack_size },
+			  in { "incremental", buffer_size, Reader { this } }
+		{
+			getcontext(&parser_context);
+			parser_context.uc_stack.ss_sp = stack.get();
+			parser_context.uc_stack.ss_size = stack_size;
+			parser_context.uc_link = &caller_context;
+			const auto self = reinterpret_cast< std::uintptr_t >(this);
+			makecontext(&parser_context, reinterpret_cast< void (*)() >(&entry), 2,
+				static_cast< unsigned >(self & 0xffffffffu), static_cast< unsigned >(static_cast< std::uint64_t >(self) >> 32));
+		}
+		IncrementalParse(const IncrementalParse&) = delete;
+		IncrementalParse& operator=(const IncrementalParse&) = delete;
+		// A parse suspended mid-input is run to its end (as if the input ended there) so that
+		// everything on its stack is destroyed properly.
+		~IncrementalParse()
+		{
+			if (started && current == ParseStatus::NeedMoreInput)
+			{
+				eof = true;
+				switch_to_parser();
+			}
+		}
+
+		// Parses as far as `data` allows.
+		ParseStatus feed(std::string_view data)
+		{
+			if (current != ParseStatus::NeedMoreInput) return current;
+			pending = data;
+			switch_to_parser();
+			return status();
+		}
+		// Signals the end of the input and runs the parse to completion.
+		ParseStatus finish()
+		{
+			if (current != ParseStatus::NeedMoreInput) return current;
+			eof = true;
+			switch_to_parser();
+			return status();
+		}
+		ParseStatus status()
+		{
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+			if (ex_ptr) std::rethrow_exception(std::exchange(ex_ptr, nullptr));
+#endif
+			return current;
+		}
+
+	private:
+		// Waits (by switching back to the caller) until it can hand `length` bytes to the
+		// buffer, then takes as much of the pending input as the buffer has room for, so the
+		// following `require()`s are served without calling back here.
+		struct Reader
+		{
+			IncrementalParse* self;
+
+			std::size_t operator()(char* buffer, std::size_t length)
+			{
+				const std::size_t room = self->in.buffer_free_after_end();
+				std::size_t filled = 0;
+				while (true)
+				{
+					const std::size_t n = std::min(self->pending.size(), room - filled);
+					std::memcpy(buffer + filled, self->pending.data(), n);
+					self->pending.remove_prefix(n);
+					filled += n;
+					if (filled >= length || self->eof) return filled;
+					self->switch_to_caller();
+				}
+			}
+		};
+		// `Chunk` of one makes `require()` ask the reader for exactly the bytes it is missing.
+		using Input = tao::pegtl::buffer_input< Reader, tao::pegtl::eol::lf_crlf, std::string, 1 >;
+
+		static void entry(unsigned lo, unsigned hi)
+		{
+			auto* self = reinterpret_cast< IncrementalParse* >(static_cast< std::uintptr_t >((static_cast< std::uint64_t >(hi) << 32) | lo));
+			self->finish_switch();
+			self->run();
+			// Returning resumes `uc_link`, i.e. the caller.
+			self->start_switch(nullptr, self->caller_stack, self->caller_stack_size);
+		}
+
+		void run()
+		{
+			bool ok = false;
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+			try
+			{
+				ok = tao::pegtl::parse< Rule, Action >(in, coro);
+			}
+			catch (...)
+			{
+				ex_ptr = std::current_exception();
+			}
+#else
+			ok = tao::pegtl::parse< Rule, Action >(in, coro);
+#endif
+			current = ok ? ParseStatus::Success : ParseStatus::Failure;
+		}
+
+		void switch_to_parser()
+		{
+			started = true;
+			void* fake_stack = nullptr;
+			start_switch(&fake_stack, stack.get(), stack_bytes);
+			swapcontext(&caller_context, &parser_context);
+			finish_switch(fake_stack);
+		}
+		void switch_to_caller()
+		{
+			void* fake_stack = nullptr;
+			start_switch(&fake_stack, caller_stack, caller_stack_size);
+			swapcontext(&parser_context, &caller_context);
+			finish_switch(fake_stack);
+		}
+
+		// AddressSanitizer has to be told about stack switches, the rest is a no-op.
+		void start_switch([[maybe_unused]] void** fake_stack, [[maybe_unused]] const void* bottom, [[maybe_unused]] std::size_t size)
+		{
+#if defined(COROPARSE_ASAN)
+			__sanitizer_start_switch_fiber(fake_stack, bottom, size);
+#endif
+		}
+		void finish_switch([[maybe_unused]] void* fake_stack = nullptr)
+		{
+#if defined(COROPARSE_ASAN)
+			const void* from_bottom = nullptr;
+			std::size_t from_size = 0;
+			__sanitizer_finish_switch_fiber(fake_stack, &from_bottom, &from_size);
+			if (from_bottom != stack.get())
+			{
+				caller_stack = from_bottom;
+				caller_stack_size = from_size;
+			}
+#endif
+		}
+
+		Coro& coro;
+		std::unique_ptr< char[] > stack;
+		std::size_t stack_bytes;
+		Input in;
+
+		ucontext_t caller_context { };
+		ucontext_t parser_context { };
+		const void* caller_stack = nullptr;
+		std::size_t caller_stack_size = 0;
+
+		std::string_view pending;
+		bool eof = false;
+		bool started = false;
+		ParseStatus current = ParseStatus::NeedMoreInput;
+		std::exception_ptr ex_ptr = nullptr;
+	};
+
+	// `auto parse = incremental_parse< Rule, Action >(coro);` then `parse.feed(bytes)` as bytes
+	// arrive and `parse.finish()` at the end of the input. Wrap `Rule` in `StreamOf` for a
+	// stream of messages, so the buffer only has to hold one message.
+	template < class Rule, template< class... > class Action = tao::pegtl::nothing, class Coro >
+	IncrementalParse< Rule, Action, Coro > incremental_parse(Coro& coro, std::size_t buffer_size = 64 * 1024, std::size_t stack_size = 256 * 1024)
+	{
+		return IncrementalParse< Rule, Action, Coro >(coro, buffer_size, stack_size);
+	}
+#endif
+}
@@ -0,0 +1,677 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <charconv>
+#include <cstdlib>
+#include <new>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if __has_include(<sys/resource.h>)
+#include <sys/resource.h>
+#endif
+
+#include <tao/pegtl/contrib/json.hpp>
+#include <tao/pegtl/contrib/parse_tree.hpp>
+
+#include "CoroParse.hpp"
+#include "CoroParseControl.hpp"
+#include "CoroParseJson.hpp"
+#include "CoroParsePipeline.hpp"
+#include "CoroParseRules.hpp"
+#include "CoroParseScan.hpp"
+
+// Every global allocation is counted so that benchmarks can report allocations per token.
+// Atomic: the Executor and pipeline benchmarks allocate from several threads.
+namespace { std::atomic< std::size_t > allocations { 0 }; }
+
+// GCC pairs the inlined `free` with `new` at call sites and warns; they do match here.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void* operator new(std::size_t n)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(n ? n : 1)) return p;
+	throw std::bad_alloc { };
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace
+{
+	using namespace coroparse;
+
+	// Quiet versions of the `pp`/`ff`/`ffa` shapes from CoroParse.hpp: descend `a` levels, take a
+	// token at the bottom, then one more token on every level on the way back up.
+	ParserProc<int> pp_shape(int a)
+	{
+		if (a == 0)
+		{
+			auto tk = co_await NextToken;
+			co_return tk ? 1 : 0;
+		}
+		int r = co_await pp_shape(a - 1);
+		auto tk = co_await NextToken;
+		co_return r + (tk ? 1 : 0);
+	}
+
+	Degenerator_<int, const std::string_view> ff_shape(int a)
+	{
+		if (a == 0)
+		{
+			auto tk = co_await NextToken;
+			co_return tk ? 1 : 0;
+		}
+		int r = co_await ff_shape(a - 1);
+		auto tk = co_await NextToken;
+		co_return r + (tk ? 1 : 0);
+	}
+
+	Degenerator<int, const std::string_view> ffa_shape(int a)
+	{
+		if (a == 0)
+		{
+			auto tk = co_await NextToken;
+			co_return tk ? 1 : 0;
+		}
+		int r = co_await ffa_shape(a - 1);
+		auto tk = co_await NextToken;
+		co_return r + (tk ? 1 : 0);
+	}
+
+	// `a` levels of nesting around a leaf that consumes every token.
+	ParserProc<int> pp_stream(int a)
+	{
+		if (a > 0) co_return co_await pp_stream(a - 1);
+		int n = 0;
+		while (co_await NextToken) ++n;
+		co_return n;
+	}
+
+	Degenerator<int, const std::string_view> ffa_stream(int a)
+	{
+		if (a > 0) co_return co_await ffa_stream(a - 1);
+		int n = 0;
+		while (co_await NextToken) ++n;
+		co_return n;
+	}
+
+	Degenerator<int, const std::string_view> ffa_stream_batched(int a, std::size_t batch)
+	{
+		if (a > 0) co_return co_await ffa_stream_batched(a - 1, batch);
+		int n = 0;
+		while (true)
+		{
+			auto tokens = co_await NextTokens{ batch };
+			if (tokens.empty()) break;
+			n += static_cast< int >(tokens.size());
+		}
+		co_return n;
+	}
+
+	const std::string_view token = "token";
+
+	long peak_rss_kb()
+	{
+#if __has_include(<sys/resource.h>)
+		rusage usage { };
+		getrusage(RUSAGE_SELF, &usage);
+		return usage.ru_maxrss;
+#else
+		return 0;
+#endif
+	}
+
+	// Reports tokens/sec, time per token (one resume per token in steady state), global
+	// allocations per token and the process' peak RSS.
+	// `allocs` is the number of allocations made inside the timed loop.
+	void report(benchmark::State& state, std::int64_t tokens_per_iteration, std::size_t allocs)
+	{
+		const auto tokens = static_cast< double >(state.iterations() * tokens_per_iteration);
+		state.SetItemsProcessed(state.iterations() * tokens_per_iteration);
+		state.counters["time_per_token"] = benchmark::Counter(tokens, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+		state.counters["allocs_per_token"] = static_cast< double >(allocs) / tokens;
+		state.counters["peak_rss_kb"] = static_cast< double >(peak_rss_kb());
+	}
+
+	// Build a chain of `depth` frames and deliver the first token to the leaf. This is the only
+	// shape all three engines support: Degenerator_ cannot resume a parent once its child is done.
+	void BM_ParserProc_Descend(benchmark::State& state)
+	{
+		const int depth = static_cast< int >(state.range(0));
+		const std::size_t before = allocations.load(std::memory_order_relaxed);
+		for (auto _ : state)
+		{
+			auto p = pp_shape(depth);
+			p.push_token(token);
+		}
+		report(state, 1, allocations.load(std::memory_order_relaxed) - before);
+	}
+	BENCHMARK(BM_ParserProc_Descend)->RangeMultiplier(8)->Range(1, 512);
+
+	void BM_Degenerator__Descend(benchmark::State& state)
+	{
+		const int depth = static_cast< int >(state.range(0));
+		const std::size_t before = allocations.load(std::memory_order_relaxed);
+		for (auto _ : state)
+		{
+			auto d = ff_shape(depth);
+			d.push_value(token);
+		}
+		report(state, 1, allocations.load(std::memory_order_relaxed) - before);
+	}
+	BENCHMARK(BM_Degenerator__Descend)->RangeMultiplier(8)->Range(1, 512);
+
+	void BM_Degenerator_Descend(benchmark::State& state)
+	{
+		const int depth = static_cast< int >(state.range(0));
+		const std::size_t before = allocations.load(std::memory_order_relaxed);
+		for (auto _ : state)
+		{
+			auto d = ffa_shape(depth);
+			d.push_value(token);
+		}
+		report(state, 1, allocations.load(std::memory_order_relaxed) - before);
+	}
+	BENCHMARK(BM_Degenerator_Descend)->RangeMultiplier(8)->Range(1, 512);
+
+	// Full `pp`/`ffa` shape: one token per level, frames finishing one after the other.
+	// Second argument: 1 to allocate frames from a FrameArena, 0 for the global heap.
+	void BM_ParserProc_Unwind(benchmark::State& state)
+	{
+		const int depth = static_cast< int >(state.range(0));
+		FrameArena arena;
+		FrameArena::Scope scope { state.range(1) ? &arena : nullptr };
+		const std::size_t before = allocations.load(std::memory_order_relaxed);
+		for (auto _ : state)
+		{
+			auto p = pp_shape(depth);
+			for (int i = 0; i <= depth; ++i) p.push_token(token);
+			benchmark::DoNotOptimize(p.result());
+		}
+		report(state, depth + 1, allocations.load(std::memory_order_relaxed) - before);
+	}
+	BENCHMARK(BM_ParserProc_Unwind)->ArgsProduct({ { 1, 8, 64, 512 }, { 0, 1 } });
+
+	void BM_Degenerator_Unwind(benchmark::State& state)
+	{
+		const int depth = static_cast< int >(state.range(0));
+		FrameArena arena;
+		FrameArena::Scope scope { state.range(1) ? &arena : nullptr };
+		const std::size_t before = allocations.load(std::memory_order_relaxed);
+		for (auto _ : state)
+		{
+			auto d = ffa_shape(depth);
+			for (int i = 0; i <= depth; ++i) d.push_value(token);
+			benchmark::DoNotOptimize(d.result());
+		}
+		report(state, depth + 1, allocations.load(std::memory_order_relaxed) - before);
+	}
+	BENCHMARK(BM_Degenerator_Unwind)->ArgsProduct({ { 1, 8, 64, 512 }, { 0, 1 } });
+
+	// Many tokens into a leaf sitting `depth` frames down: steady-state cost of a token.
+	void BM_ParserProc_Tokens(benchmark::State& state)
+	{
+		const int depth = static_cast< int >(state.range(0));
+		const auto count = state.range(1);
+		const std::size_t before = allocations.load(std::memory_order_relaxed);
+		for (auto _ : state)
+		{
+			auto p = pp_stream(depth);
+			for (std::int64_t i = 0; i < count; ++i) p.push_token(token);
+			benchmark::DoNotOptimize(p.result());
+		}
+		report(state, count, allocations.load(std::memory_order_relaxed) - before);
+	}
+	BENCHMARK(BM_ParserProc_Tokens)->ArgsProduct({ { 1, 32 }, { 1 << 10, 1 << 16 } });
+
+	void BM_Degenerator_Tokens(benchmark::State& state)
+	{
+		const int depth = static_cast< int >(state.range(0));
+		const auto count = state.range(1);
+		const std::size_t before = allocations.load(std::memory_order_relaxed);
+		for (auto _ : state)
+		{
+			auto d = ffa_stream(depth);
+			for (std::int64_t i = 0; i < count; ++i) d.push_value(token);
+			benchmark::DoNotOptimize(d.result());
+		}
+		report(state, count, allocations.load(std::memory_order_relaxed) - before);
+	}
+	BENCHMARK(BM_Degenerator_Tokens)->ArgsProduct({ { 1, 32 }, { 1 << 10, 1 << 16 } });
+
+	void BM_Degenerator_TokensBatched(benchmark::State& state)
+	{
+		const int depth = static_cast< int >(state.range(0));
+		const auto count = state.range(1);
+		const std::vector< std::string_view > tokens(static_cast< std::size_t >(count), token);
+		const std::size_t before = allocations.load(std::memory_order_relaxed);
+		for (auto _ : state)
+		{
+			auto d = ffa_stream_batched(depth, 64);
+			d.push_values(std::span< const std::string_view >(tokens));
+			benchmark::DoNotOptimize(d.result());
+		}
+		report(state, count, allocations.load(std::memory_order_relaxed) - before);
+	}
+	BENCHMARK(BM_Degenerator_TokensBatched)->ArgsProduct({ { 1, 32 }, { 1 << 10, 1 << 16 } });
+
+	Degenerator<int, const int> descend(int depth)
+	{
+		if (depth == 0)
+		{
+			auto tk = co_await NextToken;
+			co_return tk ? *tk : 0;
+		}
+		co_return co_await descend(depth - 1) + 1;
+	}
+
+	// Parent -> child -> parent transitions: one frame per level, one token at the bottom.
+	void BM_DegeneratorDeepRecursion(benchmark::State& state)
+	{
+		const int depth = static_cast< int >(state.range(0));
+		const int value = 1;
+		for (auto _ : state)
+		{
+			auto d = descend(depth);
+			d.push_value(value);
+			benchmark::DoNotOptimize(d.result());
+		}
+		state.SetItemsProcessed(state.iterations() * depth);
+	}
+	BENCHMARK(BM_DegeneratorDeepRecursion)->RangeMultiplier(10)->Range(10, 100000);
+
+	namespace pegtl = tao::pegtl;
+
+	struct Value : pegtl::plus< pegtl::digit > { };
+	struct Record : pegtl::seq< pegtl::plus< pegtl::alpha >, pegtl::one< '=' >, Value, pegtl::one< '\n' > > { };
+	struct Records : pegtl::seq< pegtl::star< Record >, pegtl::eof > { };
+	template < class Rule > struct RecordAction : pegtl::nothing< Rule > { };
+	template < > struct RecordAction< Value > : PushToken { };
+
+	std::string record_text(int count)
+	{
+		std::string text;
+		for (int i = 0; i < count; ++i) text += "key=" + std::to_string(i) + "\n";
+		return text;
+	}
+
+	Degenerator<long, const std::string_view> sum_values()
+	{
+		long sum = 0;
+		while (true)
+		{
+			auto tokens = co_await NextTokens{ 256 };
+			if (tokens.empty()) break;
+			for (std::string_view tk : tokens)
+			{
+				long v = 0;
+				std::from_chars(tk.data(), tk.data() + tk.size(), v);
+				sum += v;
+			}
+		}
+		co_return sum;
+	}
+
+	// One document of `range(0)` records, lexed and consumed on the same thread (0) or with the
+	// lexer on a second thread (1).
+	void BM_RecordsParse(benchmark::State& state)
+	{
+		const int count = static_cast< int >(state.range(0));
+		const std::string text = record_text(count);
+		const std::size_t before = allocations.load(std::memory_order_relaxed);
+		for (auto _ : state)
+		{
+			pegtl::memory_input in(text, "");
+			auto d = sum_values();
+			if (state.range(1)) pipelined_parse< Records, RecordAction >(in, d);
+			else pegtl::parse< Records, RecordAction >(in, d);
+			benchmark::DoNotOptimize(d.result());
+		}
+		report(state, count, allocations.load(std::memory_order_relaxed) - before);
+		state.SetBytesProcessed(state.iterations() * static_cast< std::int64_t >(text.size()));
+	}
+	BENCHMARK(BM_RecordsParse)->ArgsProduct({ { 1 << 16, 1 << 20 }, { 0, 1 } })->UseRealTime();
+
+	// The same document split into chunks parsed by `range(1)` workers.
+	void BM_RecordsParallel(benchmark::State& state)
+	{
+		const int count = static_cast< int >(state.range(0));
+		const std::string text = record_text(count);
+		Executor executor(static_cast< std::size_t >(state.range(1)));
+		const std::size_t before = allocations.load(std::memory_order_relaxed);
+		for (auto _ : state)
+		{
+			long sum = 0;
+			for (auto& chunk : parallel_parse< Record, RecordAction >(executor, text, [] { return sum_values(); })) sum += *chunk.value;
+			benchmark::DoNotOptimize(sum);
+		}
+		report(state, count, allocations.load(std::memory_order_relaxed) - before);
+		state.SetBytesProcessed(state.iterations() * static_cast< std::int64_t >(text.size()));
+	}
+	BENCHMARK(BM_RecordsParallel)->ArgsProduct({ { 1 << 20 }, { 1, 2, 4, 8 } })->UseRealTime();
+
+	namespace json = pegtl::json;
+	struct ArrayHead : pegtl::seq< pegtl::star< json::ws >, json::begin_array > { };
+	struct ArrayTail : pegtl::seq< json::end_array, pegtl::star< json::ws > > { };
+	struct Array : pegtl::seq< ArrayHead, pegtl::opt< pegtl::list< json::array_element, json::value_separator > >, ArrayTail, pegtl::eof > { };
+	template < class Rule > struct JsonAction : pegtl::nothing< Rule > { };
+	template < > struct JsonAction< json::number > : PushToken { };
+
+	std::string json_array(int count)
+	{
+		std::string text = "[";
+		for (int i = 0; i < count; ++i) text += (i ? "," : "") + std::string("{\"id\":") + std::to_string(i) + ",\"note\":\"a, b\"}";
+		return text + "]";
+	}
+
+	// One JSON array of `range(0)` objects: parsed sequentially (0 workers) or speculatively.
+	void BM_JsonArray(benchmark::State& state)
+	{
+		const int count = static_cast< int >(state.range(0));
+		const std::string text = json_array(count);
+		std::optional< Executor > executor;
+		if (state.range(1)) executor.emplace(static_cast< std::size_t >(state.range(1)));
+		for (auto _ : state)
+		{
+			auto d = sum_values();
+			if (executor) speculative_parse< ArrayHead, json::array_element, json::value_separator, ArrayTail, JsonAction >(*executor, text, d);
+			else
+			{
+				pegtl::memory_input in(text, "");
+				pegtl::parse< Array, JsonAction >(in, d);
+			}
+			benchmark::DoNotOptimize(d.result());
+		}
+		state.SetBytesProcessed(state.iterations() * static_cast< std::int64_t >(text.size()));
+	}
+	BENCHMARK(BM_JsonArray)->ArgsProduct({ { 1 << 18 }, { 0, 1, 4 } })->UseRealTime();
+
+	Degenerator<std::size_t, const std::string_view> count_tokens()
+	{
+		std::size_t n = 0;
+		while (true)
+		{
+			auto tokens = co_await NextTokens{ 256 };
+			if (tokens.empty()) break;
+			n += tokens.size();
+		}
+		co_return n;
+	}
+
+	template < class Rule > struct JsonLexAction : pegtl::nothing< Rule > { };
+	template < > struct JsonLexAction< json::string > : PushToken { };
+	template < > struct JsonLexAction< json::number > : PushToken { };
+
+	// Strings and numbers of a JSON document into a consumer: the full PEGTL grammar with
+	// `PushToken` (0) against the vector scanner (1).
+	void BM_JsonLex(benchmark::State& state)
+	{
+		std::string text = "[";
+		for (int i = 0; i < (1 << 15); ++i)
+			text += (i ? "," : "") + std::string("{\"id\": ") + std::to_string(i) + ", \"text\": \"Lorem ipsum dolor sit amet, consectetur adipiscing elit\"}";
+		text += "]";
+		for (auto _ : state)
+		{
+			auto d = count_tokens();
+			if (state.range(0)) scan_tokens(text, d);
+			else
+			{
+				pegtl::memory_input in(text, "");
+				pegtl::parse< json::text, JsonLexAction >(in, d);
+			}
+			benchmark::DoNotOptimize(d.result());
+		}
+		state.SetBytesProcessed(state.iterations() * static_cast< std::int64_t >(text.size()));
+	}
+	BENCHMARK(BM_JsonLex)->Arg(0)->Arg(1);
+
+	// Character runs: `star< sor< alnum, space > >` rule by rule (0) against `star_class` (1),
+	// and `star< not_one< '"', '\\' > >` (2) against `star_class` on a vector search (3).
+	void BM_CharRun(benchmark::State& state)
+	{
+		std::string text;
+		for (int i = 0; i < 4096; ++i) text += "Lorem ipsum dolor sit amet consectetur adipiscing elit ";
+		text += "\"";
+		for (auto _ : state)
+		{
+			pegtl::memory_input in(text, "");
+			switch (state.range(0))
+			{
+			case 0: pegtl::parse< pegtl::star< pegtl::sor< pegtl::alnum, pegtl::space > > >(in); break;
+			case 1: pegtl::parse< star_class< pegtl::alnum, pegtl::space > >(in); break;
+			case 2: pegtl::parse< pegtl::star< pegtl::not_one< '"', '\\' > > >(in); break;
+			default: pegtl::parse< star_class< pegtl::not_one< '"', '\\' > > >(in); break;
+			}
+			benchmark::DoNotOptimize(in.current());
+		}
+		state.SetBytesProcessed(state.iterations() * static_cast< std::int64_t >(text.size()));
+	}
+	BENCHMARK(BM_CharRun)->DenseRange(0, 3);
+
+	// JSON values, mostly scalars, through `json::value` (0) against the same alternatives
+	// in a `dispatch_sor` (1): `null` no longer fails through string, number, object, ...
+	struct DispatchValue : dispatch_sor< json::string, json::number, json::object, json::array, json::false_, json::true_, json::null > { };
+	template < class Value >
+	struct ValueList : pegtl::seq< json::begin_array, pegtl::list< Value, json::value_separator >, json::end_array, pegtl::eof > { };
+
+	void BM_JsonValueDispatch(benchmark::State& state)
+	{
+		const char* const values[] = { "null", "true", "12.5", "\"text\"", "false", "[1]", "{\"k\":null}" };
+		std::string text = "[";
+		for (int i = 0; i < (1 << 16); ++i) text += (i ? ", " : "") + std::string(values[i % std::size(values)]);
+		text += "]";
+		for (auto _ : state)
+		{
+			pegtl::memory_input in(text, "");
+			const bool ok = state.range(0) ? pegtl::parse< ValueList< DispatchValue > >(in) : pegtl::parse< ValueList< json::value > >(in);
+			benchmark::DoNotOptimize(ok);
+		}
+		state.SetBytesProcessed(state.iterations() * static_cast< std::int64_t >(text.size()));
+	}
+	BENCHMARK(BM_JsonValueDispatch)->Arg(0)->Arg(1);
+
+	// A log level out of 30, case-insensitive: one `istring` after the other in a `sor` (0)
+	// against `keywords` (1); `plus< alpha >` (2) is the floor.
+#define COROPARSE_BENCH_LEVELS TAO_PEGTL_ISTRING("abort"), TAO_PEGTL_ISTRING("alert"), TAO_PEGTL_ISTRING("audit"), TAO_PEGTL_ISTRING("critical"), TAO_PEGTL_ISTRING("debug"), TAO_PEGTL_ISTRING("emergency"), TAO_PEGTL_ISTRING("error"), TAO_PEGTL_ISTRING("fatal"), TAO_PEGTL_ISTRING("info"), TAO_PEGTL_ISTRING("notice"), TAO_PEGTL_ISTRING("panic"), TAO_PEGTL_ISTRING("severe"), TAO_PEGTL_ISTRING("trace"), TAO_PEGTL_ISTRING("verbose"), TAO_PEGTL_ISTRING("warning"), TAO_PEGTL_ISTRING("finest"), TAO_PEGTL_ISTRING("finer"), TAO_PEGTL_ISTRING("fine"), TAO_PEGTL_ISTRING("config"), TAO_PEGTL_ISTRING("all"), TAO_PEGTL_ISTRING("off"), TAO_PEGTL_ISTRING("unknown"), TAO_PEGTL_ISTRING("default"), TAO_PEGTL_ISTRING("success"), TAO_PEGTL_ISTRING("failure"), TAO_PEGTL_ISTRING("retry"), TAO_PEGTL_ISTRING("timeout"), TAO_PEGTL_ISTRING("denied"), TAO_PEGTL_ISTRING("granted"), TAO_PEGTL_ISTRING("pending")
+	struct LevelSor : pegtl::sor< COROPARSE_BENCH_LEVELS > { };
+	struct LevelKeywords : keywords< COROPARSE_BENCH_LEVELS > { };
+#undef COROPARSE_BENCH_LEVELS
+	template < class Level >
+	struct LevelList : pegtl::seq< pegtl::list< Level, pegtl::one< ' ' > >, pegtl::eof > { };
+
+	void BM_Keywords(benchmark::State& state)
+	{
+		const char* const levels[] = { "pending", "ERROR", "Info", "warning", "debug", "granted", "trace", "Fine", "finest", "audit" };
+		std::minstd_rand rng(1);
+		std::string text;
+		for (int i = 0; i < (1 << 16); ++i) text += (i ? " " : "") + std::string(levels[rng() % std::size(levels)]);
+		for (auto _ : state)
+		{
+			pegtl::memory_input in(text, "");
+			const bool ok = state.range(0) == 2 ? pegtl::parse< LevelList< pegtl::plus< pegtl::alpha > > >(in) : state.range(0) ? pegtl::parse< LevelList< LevelKeywords > >(in) : pegtl::parse< LevelList< LevelSor > >(in);
+			benchmark::DoNotOptimize(ok);
+		}
+		state.SetBytesProcessed(state.iterations() * static_cast< std::int64_t >(text.size()));
+	}
+	BENCHMARK(BM_Keywords)->Arg(0)->Arg(1)->Arg(2);
+
+	// Strings and numbers of a JSON array with the tokens delivered directly (0) or held back
+	// until the alternatives around them succeeded (1), i.e. element by element. (With
+	// `json::text` everything would wait for the end: the array is an alternative of `value`.)
+	void BM_Transactional(benchmark::State& state)
+	{
+		std::string text = "[";
+		for (int i = 0; i < (1 << 14); ++i) text += (i ? "," : "") + std::string("{\"id\": ") + std::to_string(i) + ", \"tags\": [\"a\", \"b\", 1.5, true]}";
+		text += "]";
+		for (auto _ : state)
+		{
+			auto d = count_tokens();
+			pegtl::memory_input in(text, "");
+			if (state.range(0))
+			{
+				TokenTransaction tx { d };
+				pegtl::parse< Array, JsonLexAction, transactional >(in, tx);
+			}
+			else pegtl::parse< Array, JsonLexAction >(in, d);
+			benchmark::DoNotOptimize(d.result());
+		}
+		state.SetBytesProcessed(state.iterations() * static_cast< std::int64_t >(text.size()));
+	}
+	BENCHMARK(BM_Transactional)->Arg(0)->Arg(1);
+
+	Degenerator<std::size_t, const Event> count_matches()
+	{
+		std::size_t n = 0;
+		while (true)
+		{
+			auto events = co_await NextTokens{ 256 };
+			if (events.empty()) break;
+			for (const Event& e : events) n += e.kind == EventKind::success;
+		}
+		co_return n;
+	}
+
+	// Strings and numbers of a JSON document through `PushToken` actions (0) or as events of
+	// `event_control` (1), which also reports their start and the failed attempts.
+	void BM_Events(benchmark::State& state)
+	{
+		std::string text = "[";
+		for (int i = 0; i < (1 << 14); ++i) text += (i ? "," : "") + std::string("{\"id\": ") + std::to_string(i) + ", \"tags\": [\"a\", \"b\", 1.5, true]}";
+		text += "]";
+		for (auto _ : state)
+		{
+			pegtl::memory_input in(text, "");
+			if (state.range(0))
+			{
+				auto d = count_matches();
+				parse_events< json::text, EventRules< json::string, json::number > >(in, d);
+				benchmark::DoNotOptimize(d.result());
+			}
+			else
+			{
+				auto d = count_tokens();
+				pegtl::parse< json::text, JsonLexAction >(in, d);
+				benchmark::DoNotOptimize(d.result());
+			}
+		}
+		state.SetBytesProcessed(state.iterations() * static_cast< std::int64_t >(text.size()));
+	}
+	BENCHMARK(BM_Events)->Arg(0)->Arg(1);
+
+	// Typed JSON events into a consumer that sums the numbers, against a PEGTL parse tree of
+	// the same values (`parse_tree::parse`, then a walk over it for the sum).
+	template < class Rule >
+	using JsonTreeNodes = pegtl::parse_tree::selector< Rule, pegtl::parse_tree::store_content::on< json::key_content, json::string_content,
+		json::number, json::true_, json::false_, json::null, json::object, json::array > >;
+
+	double sum_tree(const pegtl::parse_tree::node& n)
+	{
+		double sum = 0;
+		if (n.is_type< json::number >())
+		{
+			const auto text = n.string_view();
+			std::from_chars(text.data(), text.data() + text.size(), sum);
+		}
+		for (const auto& c : n.children) sum += sum_tree(*c);
+		return sum;
+	}
+
+	Degenerator<double, const JsonEvent> sum_numbers()
+	{
+		double sum = 0;
+		while (true)
+		{
+			auto events = co_await NextTokens{ 256 };
+			if (events.empty()) break;
+			for (const JsonEvent& e : events)
+				if (e.kind == JsonKind::number)
+				{
+					double v = 0;
+					std::from_chars(e.text.data(), e.text.data() + e.text.size(), v);
+					sum += v;
+				}
+		}
+		co_return sum;
+	}
+
+	void BM_JsonStream(benchmark::State& state)
+	{
+		std::string text = "[";
+		for (int i = 0; i < (1 << 14); ++i) text += (i ? "," : "") + std::string("{\"id\": ") + std::to_string(i) + ", \"name\": \"item\", \"tags\": [\"a\", 1.5, true, null]}";
+		text += "]";
+		for (auto _ : state)
+		{
+			pegtl::memory_input in(text, "");
+			if (state.range(0))
+			{
+				auto d = sum_numbers();
+				parse_json(in, d);
+				benchmark::DoNotOptimize(d.result());
+			}
+			else
+			{
+				const auto root = pegtl::parse_tree::parse< json::text, JsonTreeNodes >(in);
+				benchmark::DoNotOptimize(sum_tree(*root));
+			}
+		}
+		state.SetBytesProcessed(state.iterations() * static_cast< std::int64_t >(text.size()));
+	}
+	BENCHMARK(BM_JsonStream)->Arg(0)->Arg(1);
+
+	// Two fields of each of 256 records of ~4 KB: all events (0) against the fields selected by
+	// JSON pointers, the rest of each record skipped (1).
+	void BM_JsonPointers(benchmark::State& state)
+	{
+		std::string payload = "[";
+		for (int i = 0; i < 64; ++i) payload += (i ? "," : "") + std::string("{\"k\": \"value ") + std::to_string(i) + "\", \"n\": [1.25, 2, 3]}";
+		payload += "]";
+		std::string text = "[";
+		std::vector< std::string > pointers;
+		for (int i = 0; i < 256; ++i)
+		{
+			text += (i ? "," : "") + std::string("{\"id\": ") + std::to_string(i) + ", \"payload\": " + payload + ", \"price\": 9.5}";
+			pointers.push_back("/" + std::to_string(i) + "/id");
+			pointers.push_back("/" + std::to_string(i) + "/price");
+		}
+		text += "]";
+		const JsonPointers selected(pointers);
+		for (auto _ : state)
+		{
+			pegtl::memory_input in(text, "");
+			auto d = sum_numbers();
+			if (state.range(0)) parse_json(in, selected, d);
+			else parse_json(in, d);
+			benchmark::DoNotOptimize(d.result());
+		}
+		state.SetBytesProcessed(state.iterations() * static_cast< std::int64_t >(text.size()));
+	}
+	BENCHMARK(BM_JsonPointers)->Arg(0)->Arg(1);
+
+	// Getting past a ~1 MB JSON object: matching `json::value` rule by rule (0) against
+	// `skip_balanced` (1).
+	void BM_SkipBalanced(benchmark::State& state)
+	{
+		std::string text = "{";
+		for (int i = 0; i < (1 << 13); ++i) text += (i ? "," : "") + std::string("\"k") + std::to_string(i) + "\": {\"s\": \"a \\\"}\\\" b\", \"n\": [1.5, 2, {\"t\": true}], \"z\": null}";
+		text += "}";
+		for (auto _ : state)
+		{
+			pegtl::memory_input in(text, "");
+			const bool ok = state.range(0) ? pegtl::parse< skip_balanced< '{', '}' > >(in) : pegtl::parse< json::value >(in);
+			if (!ok || !in.empty()) state.SkipWithError("the object was not matched whole");
+		}
+		state.SetBytesProcessed(state.iterations() * static_cast< std::int64_t >(text.size()));
+	}
+	BENCHMARK(BM_SkipBalanced)->Arg(0)->Arg(1);
+}
+
+BENCHMARK_MAIN();
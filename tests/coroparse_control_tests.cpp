@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "CoroParseControl.hpp"
+
+namespace
+{
+	using namespace coroparse;
+	namespace pegtl = tao::pegtl;
+
+	Degenerator<std::vector< std::string >, const std::string_view> collect()
+	{
+		std::vector< std::string > tokens;
+		while (true)
+		{
+			auto batch = co_await NextTokens{ 8 };
+			if (batch.empty()) break;
+			for (std::string_view tk : batch) tokens.emplace_back(tk);
+		}
+		co_return std::move(tokens);
+	}
+
+	ParserProc<std::string> join()
+	{
+		std::string all;
+		while (auto tk = co_await NextToken) all += std::string(*tk) + ";";
+		co_return all;
+	}
+
+	// Records what reached it, and when.
+	struct Recorder
+	{
+		std::vector< std::string > tokens;
+		void push_token(std::string_view tk) { tokens.emplace_back(tk); }
+		bool done() { return false; }
+	};
+
+	// `1x` is a number then `x`, `1y` a number then `y`: both alternatives see the number.
+	struct Number : pegtl::plus< pegtl::digit > { };
+	struct Name : pegtl::plus< pegtl::alpha > { };
+	// `a=1!` keeps its number, `a=1` does not.
+	struct Assign : pegtl::sor< pegtl::seq< pegtl::one< '=' >, Number, pegtl::one< '!' > >, pegtl::seq< pegtl::one< '=' >, pegtl::plus< pegtl::digit > >, pegtl::success > { };
+	struct Pair : pegtl::sor< pegtl::seq< Number, pegtl::one< 'x' > >, pegtl::seq< Number, pegtl::one< 'y' > >, pegtl::seq< Name, Assign > > { };
+	struct Pairs : pegtl::seq< pegtl::list< Pair, pegtl::one< ',' > >, pegtl::eof > { };
+	struct Item : pegtl::sor< pegtl::seq< Number, pegtl::one< 'x' > >, pegtl::seq< Number, pegtl::one< 'z' > >, pegtl::seq< Name, pegtl::must< pegtl::one< '!' > > > > { };
+	struct Strict : pegtl::seq< pegtl::list< Item, pegtl::one< ',' > >, pegtl::eof > { };
+
+	template < class Rule > struct Action : pegtl::nothing< Rule > { };
+	template < > struct Action< Number > : PushToken { };
+	template < > struct Action< Name > : PushToken { };
+
+	// Checks at every `,` that the pairs before it have been delivered.
+	struct Checked : pegtl::seq< pegtl::list< Pair, pegtl::one< ',' > >, pegtl::eof > { };
+	Recorder* checked_recorder = nullptr;
+	std::vector< std::size_t > delivered_at_comma;
+	template < class Rule > struct CheckedAction : Action< Rule > { };
+	template < > struct CheckedAction< pegtl::one< ',' > >
+	{
+		template < class ActionInput >
+		static void apply(const ActionInput&, TokenTransaction< Recorder >& tx)
+		{
+			EXPECT_EQ(tx.pending_count(), 0u);
+			delivered_at_comma.push_back(checked_recorder->tokens.size());
+		}
+	};
+
+	using Strings = std::vector< std::string >;
+
+	// Events as `<id><kind>:<text>`, e.g. `0+:12` for rule 0 matching `12`.
+	Degenerator<std::vector< std::string >, const Event> describe(std::size_t batch)
+	{
+		std::vector< std::string > out;
+		while (true)
+		{
+			auto events = co_await NextTokens{ batch };
+			if (events.empty()) break;
+			for (const Event& e : events)
+			{
+				const char kind = e.kind == EventKind::start ? '>' : e.kind == EventKind::success ? '+' : '-';
+				out.push_back(std::to_string(e.rule) + kind + ":" + std::string(e.text()));
+			}
+		}
+		co_return std::move(out);
+	}
+
+	using Selected = EventRules< Name, Number, Pair >;
+
+	int items_applied = 0;
+	template < class Rule > struct CountItems : pegtl::nothing< Rule > { };
+	template < > struct CountItems< Item >
+	{
+		template < class ActionInput, class Stream >
+		static void apply(const ActionInput&, Stream&) { ++items_applied; }
+	};
+}
+
+TEST(Transactional, FailedAlternativesPushNothing)
+{
+	const std::string text = "1x,2y,ab,c=3!,d=4";
+	{
+		auto d = collect();
+		pegtl::memory_input in(text, "");
+		ASSERT_TRUE((pegtl::parse< pegtl::must< Pairs >, Action >(in, d)));
+		// Without transactions: `2` twice, `4` although `d=4` lacks the `!`.
+		EXPECT_EQ(d.result(), (Strings { "1", "2", "2", "ab", "c", "3", "d", "4" }));
+	}
+	{
+		auto d = collect();
+		TokenTransaction tx { d };
+		pegtl::memory_input in(text, "");
+		ASSERT_TRUE((pegtl::parse< pegtl::must< Pairs >, Action, transactional >(in, tx)));
+		EXPECT_EQ(tx.pending_count(), 0u);
+		EXPECT_EQ(d.result(), (Strings { "1", "2", "ab", "c", "3", "d" }));
+	}
+}
+
+TEST(Transactional, ParserProcAndExceptions)
+{
+	auto p = join();
+	TokenTransaction tx { p };
+	pegtl::memory_input in("7x,ab!,9z,cd", "");
+	EXPECT_THROW((pegtl::parse< Strict, Action, transactional >(in, tx)), pegtl::parse_error);
+	EXPECT_EQ(tx.pending_count(), 0u);
+	// `9` is matched by two alternatives but delivered once, `cd` threw.
+	EXPECT_EQ(p.result(), "7;ab;9;");
+}
+
+TEST(Transactional, DeliversAsSoonAsCommitted)
+{
+	Recorder recorder;
+	checked_recorder = &recorder;
+	TokenTransaction tx { recorder };
+	pegtl::memory_input in("1x,2y,ab", "");
+	ASSERT_TRUE((pegtl::parse< Checked, CheckedAction, transactional >(in, tx)));
+	EXPECT_EQ(delivered_at_comma, (std::vector< std::size_t > { 1, 2 }));
+	EXPECT_EQ(recorder.tokens, (Strings { "1", "2", "ab" }));
+}
+
+TEST(EventControl, StartSuccessFailure)
+{
+	static_assert(Selected::id< Pair > == 2 && Selected::id< Pairs > == -1);
+	auto d = describe(4);
+	pegtl::memory_input in("1x,2y,ab", "");
+	ASSERT_TRUE((parse_events< Pairs, Selected >(in, d)));
+	EXPECT_EQ(d.result(), (Strings {
+		"2>:", "1>:", "1+:1", "2+:1x",
+		"2>:", "1>:", "1+:2", "1>:", "1+:2", "2+:2y",
+		"2>:", "1>:", "1-:", "1>:", "1-:", "0>:", "0+:ab", "2+:ab" }));
+}
+
+TEST(EventControl, ActionsStillRunAndErrorsFlush)
+{
+	auto d = describe(64);
+	items_applied = 0;
+	pegtl::memory_input in("7x,ab!,cd", "");
+	EXPECT_THROW((parse_events< Strict, EventRules< Item >, CountItems >(in, d)), pegtl::parse_error);
+	EXPECT_EQ(items_applied, 2);
+	// What came before the error is there.
+	EXPECT_EQ(d.result(), (Strings { "0>:", "0+:7x", "0>:", "0+:ab!", "0>:" }));
+
+	auto all = describe(1);
+	pegtl::memory_input bad("1x,?", "");
+	EXPECT_FALSE((parse_events< Pairs, Selected >(bad, all)));
+	EXPECT_EQ(all.result().back(), "2-:");
+}
@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "CoroParseJson.hpp"
+
+namespace
+{
+	using namespace coroparse;
+	namespace pegtl = tao::pegtl;
+
+	Degenerator<std::vector< std::string >, const JsonEvent> describe()
+	{
+		std::vector< std::string > out;
+		const char* const names[] = { "{", "}", "[", "]", "key", "string", "number", "bool", "null", "pointer" };
+		while (true)
+		{
+			auto events = co_await NextTokens{ 16 };
+			if (events.empty()) break;
+			for (const JsonEvent& e : events) out.push_back(std::string(names[static_cast< int >(e.kind)]) + ":" + std::string(e.text));
+		}
+		co_return std::move(out);
+	}
+
+	struct Record
+	{
+		std::string name;
+		std::vector< int > values;
+		bool enabled = false;
+		int skipped = 0;
+	};
+
+	// `{"name": ..., "values": [...], "enabled": ...}` in any order; other members are skipped.
+	Degenerator<Record, const JsonEvent> read_record()
+	{
+		Record r;
+		if (!co_await json_expect(JsonKind::begin_object)) co_return ParseError { "expected an object" };
+		while (auto key = co_await json_key())
+		{
+			if (*key == "name")
+			{
+				auto name = co_await json_string();
+				if (!name) co_return ParseError { "name is not a string" };
+				unescape_json(*name, r.name);
+			}
+			else if (*key == "values")
+			{
+				if (!co_await json_expect(JsonKind::begin_array)) co_return ParseError { "values is not an array" };
+				while (auto v = co_await json_number< int >()) r.values.push_back(*v);
+			}
+			else if (*key == "enabled")
+			{
+				auto b = co_await json_bool();
+				if (!b) co_return ParseError { "enabled is not a boolean" };
+				r.enabled = *b;
+			}
+			else
+			{
+				for (JsonSkip skip; skip(co_await NextToken);) { }
+				++r.skipped;
+			}
+		}
+		co_return std::move(r);
+	}
+
+	using Strings = std::vector< std::string >;
+}
+
+TEST(ParseJson, Events)
+{
+	auto d = describe();
+	pegtl::memory_input in(R"( {"a": [1, -2.5e3, true, false, null], "b\"c": {}, "": "x,y"} )", "");
+	ASSERT_TRUE(parse_json(in, d));
+	EXPECT_EQ(d.result(), (Strings { "{:{", "key:a", "[:[", "number:1", "number:-2.5e3", "bool:true", "bool:false", "null:null", "]:]",
+		"key:b\\\"c", "{:{", "}:}", "key:", "string:x,y", "}:}" }));
+}
+
+TEST(ParseJson, InvalidDocuments)
+{
+	for (std::string text : { "[1, 2", "[1] 2", "{\"a\" 1}", "", "[01]" })
+	{
+		auto d = describe();
+		pegtl::memory_input in(text, "");
+		EXPECT_FALSE(parse_json(in, d)) << text;
+	}
+}
+
+TEST(ParseJson, ConsumerHelpers)
+{
+	auto d = read_record();
+	pegtl::memory_input in(R"({"extra": {"deep": [1, [2, {"x": 3}]]}, "values": [3, 1, 4], "name": "café 😀\n", "more": 7, "enabled": true})", "");
+	ASSERT_TRUE(parse_json(in, d));
+	const Record r = d.result();
+	EXPECT_EQ(r.name, "caf\xC3\xA9 \xF0\x9F\x98\x80\n");
+	EXPECT_EQ(r.values, (std::vector< int > { 3, 1, 4 }));
+	EXPECT_TRUE(r.enabled);
+	EXPECT_EQ(r.skipped, 2);
+
+	auto wrong = read_record();
+	pegtl::memory_input text(R"({"values": [1, 2.5]})", "");
+	ASSERT_TRUE(parse_json(text, wrong));
+	// `2.5` is no `int`: the loop stops there and `]` is read as a key.
+	const auto result = wrong.try_result();
+	ASSERT_TRUE(result.has_value());
+	EXPECT_EQ(result->values, (std::vector< int > { 1 }));
+
+	auto not_object = read_record();
+	pegtl::memory_input array("[]", "");
+	ASSERT_TRUE(parse_json(array, not_object));
+	EXPECT_FALSE(not_object.try_result().has_value());
+}
+
+TEST(ParseJson, Unescape)
+{
+	std::string out;
+	unescape_json(R"(a\"b\\c\/d\b\f\n\r\tAß€\ud800x)", out);
+	EXPECT_EQ(out, "a\"b\\c/d\b\f\n\r\tA\xC3\x9F\xE2\x82\xAC\xEF\xBF\xBDx");
+}
+
+TEST(ParseJson, Pointers)
+{
+	const JsonPointers pointers { "/store/books/1/title", "/store/name", "/a~1b", "/store/books/1/title/x", "/missing/deep" };
+	auto d = describe();
+	pegtl::memory_input in(R"({"a/b": [1, {"x": 2}], "skipped": {"a": "[{\\\"", "b": [[], {}]},
+		"store": {"books": [{"title": "One", "x": [1, 2]}, {"year": 2000, "title": {"x": "Two"}}], "name": "Shop"},
+		"missing": 5, "a\/b": "escaped"})", "");
+	ASSERT_TRUE(parse_json(in, pointers, d));
+	EXPECT_EQ(d.result(), (Strings { "pointer:/a~1b", "[:[", "number:1", "{:{", "key:x", "number:2", "}:}", "]:]",
+		"pointer:/store/books/1/title", "{:{", "key:x", "string:Two", "}:}", "pointer:/store/name", "string:Shop",
+		"pointer:/a~1b", "string:escaped" }));
+}
+
+TEST(ParseJson, PointerToTheWholeDocument)
+{
+	auto d = describe();
+	pegtl::memory_input in(" [1] ", "");
+	ASSERT_TRUE(parse_json(in, JsonPointers { "" }, d));
+	EXPECT_EQ(d.result(), (Strings { "pointer:", "[:[", "number:1", "]:]" }));
+
+	EXPECT_FALSE(JsonPointers::valid("a"));
+	EXPECT_TRUE(JsonPointers::valid("/a~1b/0"));
+	EXPECT_THROW(JsonPointers { "a" }, std::invalid_argument);
+	EXPECT_THROW(JsonPointers { "/a~2" }, std::invalid_argument);
+}
+
+TEST(ParseJson, PointersSkipWithoutValidating)
+{
+	const JsonPointers pointers { "/b" };
+	for (std::string text : { R"({"a": [1 2 +], "b": true})", R"({"a": tru, "b": true})", R"({"a": "\"]", "b": true} )" })
+	{
+		auto d = describe();
+		pegtl::memory_input in(text, "");
+		ASSERT_TRUE(parse_json(in, pointers, d)) << text;
+		EXPECT_EQ(d.result(), (Strings { "pointer:/b", "bool:true" })) << text;
+	}
+	// The structure on the way to the selected values and the values themselves are checked.
+	for (std::string text : { R"({"a": [1, 2, "b": true})", R"({"a" 1, "b": true})", R"({"b": tru})", R"({"a": "x)", R"({"b": 1} 2)" })
+	{
+		auto d = describe();
+		pegtl::memory_input in(text, "");
+		EXPECT_FALSE(parse_json(in, pointers, d)) << text;
+	}
+}
+
+TEST(ParseJson, PointersWithHelpers)
+{
+	auto sum = []() -> Degenerator<double, const JsonEvent>
+	{
+		double total = 0;
+		while (co_await json_selected())
+		{
+			auto v = co_await json_number();
+			if (!v) co_return ParseError { "not a number" };
+			total += *v;
+		}
+		co_return total;
+	};
+	auto d = sum();
+	pegtl::memory_input in(R"([{"price": 1.5, "name": "a"}, {"price": 2}, {"name": "c"}, {"price": 4}])", "");
+	ASSERT_TRUE(parse_json(in, JsonPointers { "/0/price", "/1/price", "/3/price" }, d));
+	EXPECT_EQ(d.result(), 7.5);
+}
@@ -0,0 +1,301 @@
+#include <gtest/gtest.h>
+
+#include <charconv>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <tao/pegtl/contrib/json.hpp>
+
+#include "CoroParsePipeline.hpp"
+
+namespace
+{
+	using namespace coroparse;
+	namespace pegtl = tao::pegtl;
+
+	struct Value : pegtl::plus< pegtl::digit > { };
+	struct Record : pegtl::seq< pegtl::plus< pegtl::alpha >, pegtl::one< '=' >, Value, pegtl::one< '\n' > > { };
+	struct Records : pegtl::seq< pegtl::star< Record >, pegtl::eof > { };
+	template < class Rule > struct RecordAction : pegtl::nothing< Rule > { };
+	template < > struct RecordAction< Value > : PushToken { };
+
+	long to_long(std::string_view tk)
+	{
+		long v = 0;
+		std::from_chars(tk.data(), tk.data() + tk.size(), v);
+		return v;
+	}
+
+	Degenerator<long, const std::string_view> sum_values()
+	{
+		long sum = 0;
+		while (auto tk = co_await NextToken) sum += to_long(*tk);
+		co_return sum;
+	}
+
+	Degenerator<long, const std::string_view> sum_batches()
+	{
+		long sum = 0;
+		while (true)
+		{
+			auto tokens = co_await NextTokens{ 64 };
+			if (tokens.empty()) break;
+			for (std::string_view tk : tokens) sum += to_long(tk);
+		}
+		co_return sum;
+	}
+
+	Degenerator<long, const std::string_view> first_value()
+	{
+		auto tk = co_await NextToken;
+		co_return tk ? to_long(*tk) : -1;
+	}
+
+	ParserProc<long> count_values()
+	{
+		long n = 0;
+		while (co_await NextToken) ++n;
+		co_return n;
+	}
+
+	Degenerator<std::vector< std::string >, const std::string_view> collect()
+	{
+		std::vector< std::string > tokens;
+		while (auto tk = co_await NextToken) tokens.emplace_back(*tk);
+		co_return std::move(tokens);
+	}
+
+	namespace json = pegtl::json;
+	struct ArrayHead : pegtl::seq< pegtl::star< json::ws >, json::begin_array > { };
+	struct ArrayTail : pegtl::seq< json::end_array, pegtl::star< json::ws > > { };
+	struct Array : pegtl::seq< ArrayHead, pegtl::opt< pegtl::list< json::array_element, json::value_separator > >, ArrayTail, pegtl::eof > { };
+	// A tail that takes a trailing separator, which `list<>` leaves to it.
+	struct LenientTail : pegtl::seq< pegtl::opt< json::value_separator >, ArrayTail > { };
+	struct LenientArray : pegtl::seq< ArrayHead, pegtl::opt< pegtl::list< json::array_element, json::value_separator > >, LenientTail, pegtl::eof > { };
+	template < class Rule > struct JsonAction : pegtl::nothing< Rule > { };
+	template < > struct JsonAction< json::number > : PushToken { };
+	template < > struct JsonAction< json::string_content > : PushToken { };
+
+	// Objects whose strings are full of separators, to throw the guesses off.
+	std::string json_array(int count)
+	{
+		std::string text = " [\n";
+		for (int i = 0; i < count; ++i)
+		{
+			if (i > 0) text += ",\n";
+			text += "{\"id\": " + std::to_string(i) + ", \"note\": \"" + (i % 3 ? "plain" : "a, b, [1, 2]") + "\", \"tags\": [1, 2.5, \"x,y\"]}";
+		}
+		return text + "\n] ";
+	}
+
+	template < class Grammar = Array >
+	std::vector< std::string > sequential_tokens(const std::string& text, bool& matched)
+	{
+		pegtl::memory_input in(text, "");
+		auto d = collect();
+		matched = pegtl::parse< Grammar, JsonAction >(in, d);
+		return d.result();
+	}
+
+	std::string records(int count, long& sum)
+	{
+		std::string text;
+		sum = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			text += "key=" + std::to_string(i) + "\n";
+			sum += i;
+		}
+		return text;
+	}
+}
+
+TEST(SpscRing, PreservesOrderAcrossThreads)
+{
+	constexpr std::size_t count = 1000000;
+	SpscRing< std::size_t, 256 > ring;
+	std::thread producer { [&]
+	{
+		for (std::size_t i = 0; i < count; ++i)
+			while (!ring.try_push(i)) std::this_thread::yield();
+	} };
+
+	std::vector< std::size_t > out(37);
+	std::size_t expected = 0;
+	while (expected < count)
+	{
+		const std::size_t n = ring.try_pop(out);
+		for (std::size_t i = 0; i < n; ++i) ASSERT_EQ(out[i], expected++);
+		if (n == 0) std::this_thread::yield();
+	}
+	producer.join();
+	EXPECT_EQ(ring.try_pop(out), 0u);
+}
+
+TEST(SpscRing, FullAndEmpty)
+{
+	SpscRing< int, 4 > ring;
+	for (int i = 0; i < 4; ++i) EXPECT_TRUE(ring.try_push(i));
+	EXPECT_FALSE(ring.try_push(4));
+	std::vector< int > out(3);
+	EXPECT_EQ(ring.try_pop(out), 3u);
+	EXPECT_TRUE(ring.try_push(4));
+	EXPECT_EQ(ring.try_pop(out), 2u);
+	EXPECT_EQ(out[0], 3);
+	EXPECT_EQ(out[1], 4);
+	EXPECT_EQ(ring.try_pop(out), 0u);
+}
+
+TEST(PipelinedParse, MatchesTheSequentialParse)
+{
+	long expected = 0;
+	const std::string text = records(100000, expected);
+
+	pegtl::memory_input in(text, "");
+	auto d = sum_values();
+	ASSERT_TRUE((pipelined_parse< Records, RecordAction, 64 >(in, d)));
+	EXPECT_EQ(d.result(), expected);
+
+	pegtl::memory_input batched_in(text, "");
+	auto batched = sum_batches();
+	ASSERT_TRUE((pipelined_parse< Records, RecordAction >(batched_in, batched, 64)));
+	EXPECT_EQ(batched.result(), expected);
+
+	pegtl::memory_input pp_in(text, "");
+	auto p = count_values();
+	ASSERT_TRUE((pipelined_parse< Records, RecordAction >(pp_in, p)));
+	EXPECT_EQ(p.result(), 100000);
+}
+
+TEST(PipelinedParse, FailureAndEarlyFinish)
+{
+	const std::string bad = "a=1\nb=2\nc=\n";
+	pegtl::memory_input bad_in(bad, "");
+	auto d = sum_values();
+	EXPECT_FALSE((pipelined_parse< Records, RecordAction >(bad_in, d)));
+	EXPECT_EQ(d.result(), 3);
+
+	long expected = 0;
+	const std::string text = records(10000, expected);
+	pegtl::memory_input in(text, "");
+	auto first = first_value();
+	EXPECT_TRUE((pipelined_parse< Records, RecordAction, 16 >(in, first)));
+	EXPECT_EQ(first.result(), 0);
+}
+
+TEST(SplitRecords, CutsAfterDelimiters)
+{
+	long sum = 0;
+	const std::string text = records(1000, sum);
+	const auto pieces = split_records(text, 7, '\n', 16);
+	ASSERT_EQ(pieces.size(), 7u);
+	std::string joined;
+	for (std::string_view piece : pieces)
+	{
+		EXPECT_EQ(piece.back(), '\n');
+		joined += piece;
+	}
+	EXPECT_EQ(joined, text);
+
+	// Small inputs are not split below `min_size`, the last piece may lack its delimiter.
+	EXPECT_EQ(split_records("a=1\nb=2", 8, '\n', 64).size(), 1u);
+	EXPECT_EQ(split_records("a=1\nb=2", 8, '\n', 1).back(), "b=2");
+	EXPECT_TRUE(split_records("", 8).empty());
+}
+
+TEST(ParallelParse, MergesChunksInOrder)
+{
+	long expected = 0;
+	const std::string text = records(200000, expected);
+	Executor executor(4);
+	const auto chunks = parallel_parse< Record, RecordAction >(executor, text, [] { return sum_values(); }, '\n', 4096);
+	EXPECT_GT(chunks.size(), 1u);
+
+	long sum = 0;
+	const char* next = text.data();
+	for (const auto& chunk : chunks)
+	{
+		EXPECT_EQ(chunk.text.data(), next);
+		next += chunk.text.size();
+		EXPECT_TRUE(chunk.matched);
+		sum += *chunk.value;
+	}
+	EXPECT_EQ(next, text.data() + text.size());
+	EXPECT_EQ(sum, expected);
+}
+
+TEST(ParallelParse, ReportsTheFailingChunk)
+{
+	long expected = 0;
+	std::string text = records(20000, expected);
+	text.replace(text.find("key=15000"), 9, "key=oops!");
+	Executor executor(2);
+	const auto chunks = parallel_parse< Record, RecordAction >(executor, text, [] { return count_values(); }, '\n', 4096);
+
+	std::size_t failed = 0;
+	for (const auto& chunk : chunks)
+		if (!chunk.matched)
+		{
+			++failed;
+			EXPECT_NE(chunk.text.find("key=oops!"), std::string_view::npos);
+		}
+	EXPECT_EQ(failed, 1u);
+}
+
+TEST(SpeculativeParse, SameTokensAsTheSequentialParse)
+{
+	const std::string text = json_array(20000);
+	bool matched = false;
+	const auto expected = sequential_tokens(text, matched);
+	ASSERT_TRUE(matched);
+
+	Executor executor(4);
+	auto d = collect();
+	const auto r = speculative_parse< ArrayHead, json::array_element, json::value_separator, ArrayTail, JsonAction >(executor, text, d, 4096);
+	EXPECT_TRUE(r.matched);
+	EXPECT_GT(r.chunks, 1u);
+	EXPECT_GT(r.reparsed, 0u); // Some cuts land in the string literals.
+	EXPECT_LT(r.reparsed, r.chunks);
+	EXPECT_EQ(d.result(), expected);
+}
+
+TEST(SpeculativeParse, EmptyAndMalformedLists)
+{
+	Executor executor(2);
+	for (const std::string text : { "[]", " [ 1 ]", "[1,2,]", "[1 2]", "[" })
+	{
+		bool matched = false;
+		const auto expected = sequential_tokens(text, matched);
+		auto d = collect();
+		const auto r = speculative_parse< ArrayHead, json::array_element, json::value_separator, ArrayTail, JsonAction >(executor, text, d, 1);
+		EXPECT_EQ(r.matched, matched) << text;
+		EXPECT_EQ(d.result(), expected) << text;
+	}
+
+	std::string broken = json_array(5000);
+	broken[broken.find("{\"id\"", broken.size() / 2)] = '#';
+	bool matched = true;
+	const auto expected = sequential_tokens(broken, matched);
+	ASSERT_FALSE(matched);
+	auto d = collect();
+	EXPECT_FALSE((speculative_parse< ArrayHead, json::array_element, json::value_separator, ArrayTail, JsonAction >(executor, broken, d, 4096).matched));
+	EXPECT_EQ(d.result(), expected);
+}
+
+TEST(SpeculativeParse, SeparatorWithoutAnItemBelongsToTheTail)
+{
+	Executor executor(2);
+	std::string big = json_array(3000);
+	big.insert(big.rfind(']') - 1, ",");
+	for (const std::string& text : std::vector< std::string > { "[1,]", "[1,2,]", "[,]", "[1,,]", "[1,2,3,4,5,6,7,8,9,]", big })
+		for (std::size_t min_chunk : { 1, 4, 4096 })
+		{
+			bool matched = false;
+			const auto expected = sequential_tokens< LenientArray >(text, matched);
+			auto d = collect();
+			const auto r = speculative_parse< ArrayHead, json::array_element, json::value_separator, LenientTail, JsonAction >(executor, text, d, min_chunk);
+			EXPECT_EQ(r.matched, matched) << text.substr(0, 40) << " " << min_chunk;
+			EXPECT_EQ(d.result(), expected) << text.substr(0, 40) << " " << min_chunk;
+		}
+}
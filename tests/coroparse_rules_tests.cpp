@@ -0,0 +1,196 @@
+#include <gtest/gtest.h>
+
+#include <cctype>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <tao/pegtl/contrib/analyze.hpp>
+#include <tao/pegtl/contrib/json.hpp>
+
+#include "CoroParseRules.hpp"
+
+namespace
+{
+	using namespace coroparse;
+	namespace pegtl = tao::pegtl;
+	namespace json = pegtl::json;
+
+	std::string first_bytes(const FirstSet& f)
+	{
+		std::string s;
+		for (std::size_t i = 0; i < 256; ++i)
+			if (f.bytes[i]) s += static_cast< char >(i);
+		return s;
+	}
+
+	struct Value : dispatch_sor< json::string, json::number, json::object, json::array, json::false_, json::true_, json::null > { };
+	struct Values : pegtl::seq< pegtl::star< json::ws >, pegtl::list< Value, json::value_separator >, pegtl::eof > { };
+	struct ValuesSor : pegtl::seq< pegtl::star< json::ws >, pegtl::list< json::value, json::value_separator >, pegtl::eof > { };
+
+	// Every rule that succeeds appends its name, so both grammars must run the same actions.
+	template < class Rule > struct Trace : pegtl::nothing< Rule > { };
+	template < > struct Trace< json::string > { static void apply0(std::string& log) { log += 's'; } };
+	template < > struct Trace< json::number > { static void apply0(std::string& log) { log += 'n'; } };
+	template < > struct Trace< json::object > { static void apply0(std::string& log) { log += 'o'; } };
+	template < > struct Trace< json::array > { static void apply0(std::string& log) { log += 'a'; } };
+	template < > struct Trace< json::true_ > { static void apply0(std::string& log) { log += 't'; } };
+
+	struct Keyword : pegtl::sor< TAO_PEGTL_ISTRING("if"), TAO_PEGTL_STRING("else") > { };
+	struct MaybeSigned : pegtl::seq< pegtl::opt< pegtl::one< '+', '-' > >, pegtl::plus< pegtl::digit > > { };
+	struct Word : pegtl::plus< pegtl::alpha > { };
+	// `must` throws instead of failing: it has to be tried on every byte.
+	struct Strict : pegtl::seq< pegtl::opt< pegtl::one< '!' > >, pegtl::must< pegtl::one< 'x' > > > { };
+	struct Choice : dispatch_sor< MaybeSigned, Word, pegtl::eof > { };
+	struct StrictChoice : dispatch_sor< Word, Strict > { };
+
+	struct Level : keywords< TAO_PEGTL_ISTRING("error"), TAO_PEGTL_ISTRING("warning"), TAO_PEGTL_STRING("in"),
+		TAO_PEGTL_STRING("int"), TAO_PEGTL_STRING("integer"), TAO_PEGTL_STRING("Error"), TAO_PEGTL_STRING("e\n") > { };
+	struct Levels : pegtl::seq< pegtl::list< Level, pegtl::one< ' ' > >, pegtl::eof > { };
+	template < class Rule > struct LevelAction : pegtl::nothing< Rule > { };
+	template < > struct LevelAction< Level > : PushKeyword< Level > { };
+
+	Degenerator<std::vector< int >, const int> collect_ids()
+	{
+		std::vector< int > ids;
+		while (true)
+		{
+			auto batch = co_await NextTokens{ 16 };
+			if (batch.empty()) break;
+			ids.insert(ids.end(), batch.begin(), batch.end());
+		}
+		co_return std::move(ids);
+	}
+
+	// Longest match and its length, the way a `sor` tried longest keyword first would.
+	std::pair< int, std::size_t > reference(std::string_view text, const std::vector< std::pair< std::string, bool > >& words)
+	{
+		std::pair< int, std::size_t > best { -1, 0 };
+		for (std::size_t k = 0; k < words.size(); ++k)
+		{
+			const auto& [word, fold] = words[k];
+			if (word.size() > text.size() || word.size() <= best.second) continue;
+			bool same = true;
+			for (std::size_t i = 0; i < word.size() && same; ++i)
+				same = text[i] == word[i] || (fold && std::isalpha(static_cast< unsigned char >(word[i])) && (text[i] | 0x20) == (word[i] | 0x20));
+			if (same) best = { static_cast< int >(k), word.size() };
+		}
+		return best;
+	}
+
+	// `Set` on random strings of up to `max_size` bytes out of `alphabet`.
+	template < class Set >
+	void check_keywords(const std::vector< std::pair< std::string, bool > >& words, std::string_view alphabet, std::size_t max_size)
+	{
+		std::mt19937 rng(11);
+		for (int round = 0; round < 5000; ++round)
+		{
+			std::string text;
+			for (std::size_t n = rng() % max_size; n > 0; --n) text += alphabet[rng() % alphabet.size()];
+			if (rng() % 2) text = words[rng() % words.size()].first.substr(0, rng() % 24) + text;
+			const auto [id, length] = reference(text, words);
+			pegtl::memory_input in(text, "");
+			ASSERT_EQ(pegtl::parse< Set >(in), id >= 0) << text;
+			if (id < 0) continue;
+			EXPECT_EQ(static_cast< std::size_t >(in.current() - in.begin()), length) << text;
+			EXPECT_EQ(Set::id(std::string_view(text).substr(0, length)), id) << text;
+		}
+	}
+}
+
+TEST(FirstSet, OfJsonRules)
+{
+	EXPECT_EQ(first_bytes(first_set_v< json::string >), "\"");
+	EXPECT_EQ(first_bytes(first_set_v< json::number >), "-0123456789");
+	EXPECT_EQ(first_bytes(first_set_v< json::object >), "{");
+	EXPECT_EQ(first_bytes(first_set_v< json::false_ >), "f");
+	EXPECT_FALSE(first_set_v< json::value >.nullable);
+	EXPECT_EQ(first_bytes(first_set_v< json::value >), "\"-0123456789[fnt{");
+	EXPECT_EQ(first_bytes(first_set_v< Keyword >), "Iei");
+	EXPECT_TRUE(first_set_v< pegtl::star< pegtl::digit > >.nullable);
+	EXPECT_TRUE(first_set_v< Strict >.nullable); // `must` may do anything.
+	EXPECT_EQ(first_bytes(first_set_v< plus_class< pegtl::one< 'a', 'b' > > >), "ab");
+}
+
+TEST(DispatchSor, SameResultAsSor)
+{
+	std::mt19937 rng(3);
+	const char* const pieces[] = { "1", "-2.5", "\"s\"", "true", "false", "null", "[1,{\"k\":[]}]", "{}", "tru", "x", ",", " " };
+	for (int round = 0; round < 2000; ++round)
+	{
+		std::string text;
+		for (int n = static_cast< int >(rng() % 6); n >= 0; --n) text += pieces[rng() % std::size(pieces)];
+
+		std::string log_dispatch, log_sor;
+		pegtl::memory_input a(text, ""), b(text, "");
+		const bool ok_dispatch = pegtl::parse< Values, Trace >(a, log_dispatch);
+		const bool ok_sor = pegtl::parse< ValuesSor, Trace >(b, log_sor);
+		ASSERT_EQ(ok_dispatch, ok_sor) << text;
+		EXPECT_EQ(log_dispatch, log_sor) << text;
+		EXPECT_EQ(a.current(), b.current()) << text;
+	}
+}
+
+TEST(DispatchSor, EmptyAlternativesAndMust)
+{
+	pegtl::memory_input empty("", "");
+	EXPECT_TRUE(pegtl::parse< Choice >(empty));
+	pegtl::memory_input sign("-12", "");
+	EXPECT_TRUE((pegtl::parse< pegtl::seq< Choice, pegtl::eof > >(sign)));
+	pegtl::memory_input other("#", "");
+	EXPECT_FALSE(pegtl::parse< Choice >(other));
+
+	pegtl::memory_input word("abc", "");
+	EXPECT_TRUE(pegtl::parse< StrictChoice >(word));
+	pegtl::memory_input strict("#", "");
+	EXPECT_THROW(pegtl::parse< StrictChoice >(strict), pegtl::parse_error);
+
+	EXPECT_EQ(pegtl::analyze< Values >(-1), 0u);
+}
+
+TEST(Keywords, IdsAndLongestMatch)
+{
+	EXPECT_EQ(Level::id("error"), 0);
+	EXPECT_EQ(Level::id("ERROR"), 0); // The case-insensitive one is listed first.
+	EXPECT_EQ(Level::id("WarNing"), 1);
+	EXPECT_EQ(Level::id("in"), 2);
+	EXPECT_EQ(Level::id("int"), 3);
+	EXPECT_EQ(Level::id("integer"), 4);
+	EXPECT_EQ(Level::id("e\n"), 6);
+	EXPECT_EQ(Level::id("INT"), -1);
+	EXPECT_EQ(Level::id("inte"), -1);
+	EXPECT_EQ(Level::id(""), -1);
+	EXPECT_EQ(first_bytes(first_set_v< Level >), "EWeiw");
+
+	auto d = collect_ids();
+	pegtl::memory_input in("integer int ERROR in warning e\n", "");
+	ASSERT_TRUE((pegtl::parse< Levels, LevelAction >(in, d)));
+	EXPECT_EQ(d.result(), (std::vector< int > { 4, 3, 0, 2, 1, 6 }));
+	EXPECT_EQ(in.position().line, 2u);
+
+	pegtl::memory_input partial("inte", "");
+	EXPECT_TRUE(pegtl::parse< Level >(partial));
+	EXPECT_EQ(partial.current() - partial.begin(), 3);
+	pegtl::memory_input none("xyz", "");
+	EXPECT_FALSE(pegtl::parse< Level >(none));
+	EXPECT_EQ(pegtl::analyze< Levels >(-1), 0u);
+}
+
+TEST(Keywords, MatchesLongestAlternative)
+{
+	using Set = keywords< TAO_PEGTL_STRING("ab"), TAO_PEGTL_ISTRING("Ab"), TAO_PEGTL_STRING("abc"), TAO_PEGTL_ISTRING("abd"),
+		TAO_PEGTL_STRING("b"), TAO_PEGTL_ISTRING("ba-"), TAO_PEGTL_STRING("bA-c"), TAO_PEGTL_STRING("a") >;
+	const std::vector< std::pair< std::string, bool > > words { { "ab", false }, { "Ab", true }, { "abc", false }, { "abd", true },
+		{ "b", false }, { "ba-", true }, { "bA-c", false }, { "a", false } };
+
+	check_keywords< Set >(words, "abABcd-x", 6);
+}
+
+TEST(Keywords, LongerThanOneWord)
+{
+	using Set = keywords< TAO_PEGTL_STRING("abababababab"), TAO_PEGTL_ISTRING("ABABABABA"), TAO_PEGTL_ISTRING("abab-abab-abab-abab"),
+		TAO_PEGTL_STRING("ab"), TAO_PEGTL_ISTRING("ABABABAB"), TAO_PEGTL_STRING("abababababababab-") >;
+	const std::vector< std::pair< std::string, bool > > words { { "abababababab", false }, { "ABABABABA", true }, { "abab-abab-abab-abab", true },
+		{ "ab", false }, { "ABABABAB", true }, { "abababababababab-", false } };
+	check_keywords< Set >(words, "ababaB-", 22);
+}
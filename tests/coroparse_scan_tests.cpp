@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <tao/pegtl/contrib/analyze.hpp>
+
+#include "CoroParseScan.hpp"
+
+namespace
+{
+	using namespace coroparse;
+	namespace pegtl = tao::pegtl;
+
+	Degenerator<std::vector< std::string >, const std::string_view> collect()
+	{
+		std::vector< std::string > tokens;
+		while (true)
+		{
+			auto batch = co_await NextTokens{ 64 };
+			if (batch.empty()) break;
+			for (std::string_view tk : batch) tokens.emplace_back(tk);
+		}
+		co_return std::move(tokens);
+	}
+
+	std::vector< std::string > scan(std::string_view text, bool& ok)
+	{
+		auto d = collect();
+		ok = scan_tokens(text, d);
+		return d.result();
+	}
+
+	using Strings = std::vector< std::string >;
+
+	// Match length and final line of `Rule` at the start of `text`, or -1 if it fails.
+	template < class Rule >
+	std::pair< long, std::size_t > run(const std::string& text)
+	{
+		pegtl::memory_input in(text, "");
+		if (!pegtl::parse< Rule >(in)) return { -1, 0 };
+		return { static_cast< long >(in.current() - text.data()), in.position().line };
+	}
+
+	struct Quoted : pegtl::seq< pegtl::one< '"' >, star_class< pegtl::not_one< '"', '\\' > >, pegtl::one< '"' > > { };
+	struct Looping : pegtl::star< star_class< pegtl::alpha > > { };
+}
+
+TEST(FindFirstOf, MatchesTheScalarLoop)
+{
+	std::mt19937 rng(7);
+	std::string text(1000, 'a');
+	const std::array< char, 3 > set { '"', '\\', ',' };
+	for (int round = 0; round < 2000; ++round)
+	{
+		for (char& c : text) c = "abc\",\\ x"[rng() % 8 ? 0 : rng() % 8];
+		const std::size_t begin = rng() % 64;
+		const std::size_t end = begin + rng() % (text.size() - begin);
+		const char* b = text.data() + begin;
+		const char* e = text.data() + end;
+		ASSERT_EQ(find_first_of(b, e, set), detail::find_first_of_scalar(b, e, set));
+	}
+	const std::string none(100, 'z');
+	EXPECT_EQ((find_first_of< CharSet< '{', '}' > >(none.data(), none.data() + none.size())), none.data() + none.size());
+}
+
+TEST(ScanTokens, JsonDocument)
+{
+	bool ok = false;
+	const auto tokens = scan(R"( {"a": [1, -2.5e3, true], "b\"c": null, "": "x,y"} )", ok);
+	EXPECT_TRUE(ok);
+	EXPECT_EQ(tokens, (Strings { "{", "\"a\"", ":", "[", "1", ",", "-2.5e3", ",", "true", "]", ",",
+		"\"b\\\"c\"", ":", "null", ",", "\"\"", ":", "\"x,y\"", "}" }));
+}
+
+TEST(ScanTokens, LongStringsAndUnterminatedOnes)
+{
+	const std::string body(300, 'x');
+	bool ok = false;
+	const std::string text = "[\"" + body + "\\\\\", \"" + body + "\\\"" + body + "\"]";
+	const auto tokens = scan(text, ok);
+	EXPECT_TRUE(ok);
+	ASSERT_EQ(tokens.size(), 5u);
+	EXPECT_EQ(tokens[1], "\"" + body + "\\\\\"");
+	EXPECT_EQ(tokens[3], "\"" + body + "\\\"" + body + "\"");
+
+	const auto partial = scan("[1, \"never closed\\\"]", ok);
+	EXPECT_FALSE(ok);
+	EXPECT_EQ(partial, (Strings { "[", "1", "," }));
+}
+
+TEST(ScanTokens, ErrorSyntax)
+{
+	bool ok = false;
+	auto d = collect();
+	ok = scan_tokens< ScanSyntax< CharSet< '[', ']', ',' >, CharSet< '"', '\'' >, 0 > >("error['low pressure',error[\"it's\"]]", d);
+	EXPECT_TRUE(ok);
+	EXPECT_EQ(d.result(), (Strings { "error", "[", "'low pressure'", ",", "error", "[", "\"it's\"", "]", "]" }));
+}
+
+TEST(ScanTokens, ManyBatches)
+{
+	std::string text = "[";
+	for (int i = 0; i < 10000; ++i) text += (i ? ", " : "") + std::to_string(i);
+	text += "]";
+	bool ok = false;
+	const auto tokens = scan(text, ok);
+	EXPECT_TRUE(ok);
+	ASSERT_EQ(tokens.size(), 2u + 10000u + 9999u);
+	EXPECT_EQ(tokens[2 * 9999 + 1], "9999");
+}
+
+TEST(ClassRun, SameMatchesAsTheRuleByRule)
+{
+	std::mt19937 rng(11);
+	for (int round = 0; round < 500; ++round)
+	{
+		std::string text(rng() % 300, ' ');
+		for (char& c : text) c = "ab1 \n_\"\\\xe9"[rng() % 9];
+
+		EXPECT_EQ((run< star_class< pegtl::alnum, pegtl::space > >(text)), (run< pegtl::star< pegtl::sor< pegtl::alnum, pegtl::space > > >(text)));
+		EXPECT_EQ((run< plus_class< pegtl::alpha, pegtl::one< '_' > > >(text)), (run< pegtl::plus< pegtl::sor< pegtl::alpha, pegtl::one< '_' > > > >(text)));
+		EXPECT_EQ((run< star_class< pegtl::not_one< '"', '\\' > > >(text)), (run< pegtl::star< pegtl::not_one< '"', '\\' > > >(text)));
+	}
+	EXPECT_EQ(run< Quoted >("\"" + std::string(100, 'x') + "\"").first, 102);
+}
+
+TEST(ClassRun, AnalyzeSeesThroughIt)
+{
+	EXPECT_EQ(pegtl::analyze< Quoted >(-1), 0u);
+	// A star of something that may match nothing loops forever.
+	EXPECT_NE(pegtl::analyze< Looping >(-1), 0u);
+}
+
+namespace
+{
+	struct RefString : pegtl::seq< pegtl::one< '"' >, pegtl::star< pegtl::sor< pegtl::seq< pegtl::one< '\\' >, pegtl::any >, pegtl::not_one< '"' > > >, pegtl::one< '"' > > { };
+	struct RefBalanced : pegtl::seq< pegtl::one< '(' >, pegtl::star< pegtl::sor< RefString, RefBalanced, pegtl::not_one< '(', ')', '"' > > >, pegtl::one< ')' > > { };
+	struct Skipped : pegtl::seq< pegtl::one< 'x' >, skip_balanced< '(', ')' >, pegtl::one< 'y' > > { };
+}
+
+TEST(SkipBalanced, SameMatchesAsTheRecursiveRule)
+{
+	std::mt19937 rng(5);
+	for (int round = 0; round < 2000; ++round)
+	{
+		// Mostly balanced nesting, with strings, escapes and line ends in and around them.
+		std::string text = "(";
+		for (std::size_t n = rng() % 400; n > 0; --n) text += "((()))\"\\ a\n"[rng() % 11];
+		for (std::size_t n = rng() % 8; n > 0; --n) text += ')';
+		EXPECT_EQ((run< skip_balanced< '(', ')' > >(text)), (run< RefBalanced >(text))) << text;
+	}
+	EXPECT_EQ((run< skip_balanced< '(', ')' > >(")")), (std::pair< long, std::size_t > { -1, 0 }));
+	EXPECT_EQ((run< skip_balanced< '(', ')', 0, 0 > >("(\")\")")), (std::pair< long, std::size_t > { 3, 1 }));
+	// A string escape in the last byte of a vector block.
+	const std::string escaped = "(" + std::string(29, ' ') + "\"\\\")\" )";
+	EXPECT_EQ((run< skip_balanced< '(', ')' > >(escaped).first), static_cast< long >(escaped.size()));
+	EXPECT_EQ(run< Skipped >("x(()\n)y").first, 7);
+	EXPECT_EQ((find_balanced_end< '[', ']' >(escaped.data(), escaped.data() + escaped.size())), nullptr);
+}
+
+TEST(SkipBalanced, BufferInputReadInPieces)
+{
+	// Read 64 bytes at a time into a 512-byte buffer: the scan state carries over the reads.
+	std::string text = "x(";
+	for (int i = 0; i < 40; ++i) text += i % 3 ? "(\")\\\"\") " : "\n() ";
+	text += ")y";
+	std::istringstream stream(text);
+	pegtl::istream_input< pegtl::eol::lf_crlf, 64 > in(stream, 512, "stream");
+	ASSERT_TRUE(pegtl::parse< Skipped >(in));
+	EXPECT_TRUE(in.empty());
+	EXPECT_EQ(in.position().line, 15u);
+
+	std::istringstream open("x((\")\")y");
+	pegtl::istream_input< pegtl::eol::lf_crlf, 64 > unbalanced(open, 512, "stream");
+	EXPECT_FALSE(pegtl::parse< Skipped >(unbalanced));
+}
+
+TEST(SkipBalanced, AnalyzeSeesThroughIt)
+{
+	EXPECT_EQ((pegtl::analyze< pegtl::star< skip_balanced< '{', '}' > > >(-1)), 0u);
+}
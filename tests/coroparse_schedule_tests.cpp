@@ -0,0 +1,234 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CoroParseSchedule.hpp"
+
+namespace
+{
+	using namespace coroparse;
+
+	Degenerator<int, const int> sum_one_by_one()
+	{
+		int sum = 0;
+		while (auto tk = co_await NextToken) sum += *tk;
+		co_return sum;
+	}
+
+	Degenerator<int, const int> sum_in_batches(std::vector< std::size_t >& batch_sizes)
+	{
+		int sum = 0;
+		while (true)
+		{
+			auto tokens = co_await NextTokens{ 1000 };
+			if (tokens.empty()) break;
+			batch_sizes.push_back(tokens.size());
+			for (int tk : tokens) sum += tk;
+		}
+		co_return sum;
+	}
+
+	Degenerator<int, const int> reject_zero()
+	{
+		int sum = 0;
+		while (auto tk = co_await NextToken)
+		{
+			if (*tk == 0) co_return ParseError { "zero" };
+			sum += *tk;
+		}
+		co_return sum;
+	}
+
+	Degenerator<int, const int> take_two()
+	{
+		int a = *co_await NextToken;
+		int b = *co_await NextToken;
+		co_return a + b;
+	}
+
+	// Fails the parse if two threads ever resume the session's frames at the same time.
+	Degenerator<int, const int> sum_exclusively(std::atomic< bool >& running)
+	{
+		int sum = 0;
+		while (true)
+		{
+			auto tokens = co_await NextTokens{ 16 };
+			if (running.exchange(true)) co_return ParseError { "resumed concurrently" };
+			for (int tk : tokens) sum += tk;
+			running = false;
+			if (tokens.empty()) break;
+		}
+		co_return sum;
+	}
+
+	ParserProc<int> count_words(int depth)
+	{
+		if (depth > 0) co_return co_await count_words(depth - 1);
+		int n = 0;
+		while (co_await NextToken) ++n;
+		co_return n;
+	}
+}
+
+TEST(Scheduler, ManySessions)
+{
+	std::map< std::size_t, int > results;
+	Scheduler<int, const int> scheduler([&](std::size_t id, Expected< int > r) { results[id] = *r; }, 8);
+
+	std::vector< std::size_t > ids;
+	for (int i = 0; i < 1000; ++i) ids.push_back(scheduler.spawn(sum_one_by_one()));
+	for (int round = 0; round < 10; ++round)
+	{
+		for (int i = 0; i < 1000; ++i) scheduler.post(ids[i], i);
+		scheduler.run();
+	}
+	for (auto id : ids) scheduler.close(id);
+	scheduler.run();
+
+	ASSERT_EQ(results.size(), 1000u);
+	for (int i = 0; i < 1000; ++i) EXPECT_EQ(results[ids[i]], 10 * i);
+	EXPECT_EQ(scheduler.session_count(), 0u);
+}
+
+TEST(Scheduler, FairBatching)
+{
+	std::vector< std::size_t > order;
+	std::vector< std::size_t > batch_sizes;
+	Scheduler<int, const int> scheduler([&](std::size_t id, Expected< int >) { order.push_back(id); }, 4);
+
+	auto busy = scheduler.spawn(sum_in_batches(batch_sizes));
+	auto quiet = scheduler.spawn(sum_one_by_one());
+	for (int i = 0; i < 100; ++i) scheduler.post(busy, 1);
+	scheduler.close(busy);
+	scheduler.post(quiet, 1);
+	scheduler.close(quiet);
+
+	EXPECT_EQ(scheduler.ready_count(), 2u);
+	EXPECT_TRUE(scheduler.run_once());
+	EXPECT_TRUE(scheduler.is_ready(busy));
+	scheduler.run();
+
+	// The quiet session finished long before the busy one was drained.
+	EXPECT_EQ(order, (std::vector< std::size_t > { quiet, busy }));
+	EXPECT_EQ(batch_sizes, std::vector< std::size_t >(25, 4));
+}
+
+TEST(Scheduler, RejectedAndEarlyFinishedSessions)
+{
+	std::map< std::size_t, Expected< int > > results;
+	Scheduler<int, const int> scheduler([&](std::size_t id, Expected< int > r) { results.emplace(id, std::move(r)); });
+
+	auto rejecting = scheduler.spawn(reject_zero());
+	auto early = scheduler.spawn(take_two());
+	for (int tk : { 3, 0, 5 }) scheduler.post(rejecting, tk);
+	for (int tk : { 1, 2, 3, 4 }) scheduler.post(early, tk);
+	scheduler.run();
+
+	// Neither needed close(): one rejected its input, the other stopped asking for tokens.
+	ASSERT_EQ(results.size(), 2u);
+	EXPECT_EQ(results.at(rejecting).error().message, "zero");
+	EXPECT_EQ(*results.at(early), 3);
+
+	// Slots are reused under new ids: the old ones name no session any more.
+	auto next = scheduler.spawn(take_two());
+	EXPECT_NE(next, rejecting);
+	EXPECT_NE(next, early);
+	for (int tk : { 1000, 1 }) scheduler.post(early, tk);
+	scheduler.close(rejecting);
+	EXPECT_FALSE(scheduler.is_ready(early));
+	EXPECT_EQ(scheduler.ready_count(), 0u);
+	for (int tk : { 10, 20 }) scheduler.post(next, tk);
+	scheduler.run();
+	EXPECT_EQ(*results.at(next), 30);
+	EXPECT_EQ(scheduler.session_count(), 0u);
+}
+
+TEST(Executor, RunsNestedTasksOnAllWorkers)
+{
+	std::atomic< int > count { 0 };
+	std::mutex mutex;
+	std::set< std::thread::id > threads;
+	{
+		Executor executor(4);
+		// One task fanning out from a single worker's deque: the others have to steal.
+		executor.submit([&]
+		{
+			for (int i = 0; i < 400; ++i)
+			{
+				executor.submit([&]
+				{
+					std::this_thread::sleep_for(std::chrono::microseconds(50));
+					std::lock_guard< std::mutex > lock { mutex };
+					threads.insert(std::this_thread::get_id());
+					++count;
+				});
+			}
+		});
+		executor.wait();
+		EXPECT_EQ(count.load(), 400);
+		EXPECT_GT(executor.steal_count(), 0u);
+		EXPECT_GT(threads.size(), 1u);
+	}
+}
+
+TEST(Executor, ManyParallelSessions)
+{
+	constexpr int sessions = 200;
+	std::vector< std::atomic< bool > > running(sessions);
+	std::vector< Expected< int > > results(sessions, ParseError { "not completed" });
+	std::atomic< int > completed { 0 };
+	{
+		Executor executor(4);
+		std::vector< std::shared_ptr< ParallelSession< Degenerator<int, const int> > > > handles;
+		for (int i = 0; i < sessions; ++i)
+		{
+			handles.push_back(spawn_session(executor, sum_exclusively(running[i]), [&, i](Expected< int > r)
+			{
+				results[i] = std::move(r);
+				++completed;
+			}, 16));
+		}
+		// Two producer threads posting to every session while the workers consume.
+		auto produce = [&](int first)
+		{
+			for (int round = 0; round < 50; ++round)
+				for (int i = first; i < sessions; i += 2) handles[i]->post(round);
+		};
+		std::thread a { produce, 0 }, b { produce, 1 };
+		a.join();
+		b.join();
+		for (auto& h : handles) h->close();
+		executor.wait();
+	}
+	ASSERT_EQ(completed.load(), sessions);
+	for (int i = 0; i < sessions; ++i)
+	{
+		ASSERT_TRUE(results[i].has_value()) << results[i].error().message;
+		EXPECT_EQ(*results[i], 49 * 50 / 2);
+	}
+}
+
+TEST(Executor, ParserProcSessions)
+{
+	std::atomic< int > total { 0 };
+	{
+		Executor executor(2);
+		auto deep = spawn_session(executor, count_words(3), [&](Expected< int > r) { total += *r; });
+		auto flat = spawn_session(executor, count_words(0), [&](Expected< int > r) { total += *r; });
+		for (int i = 0; i < 100; ++i)
+		{
+			deep->post("word");
+			flat->post("word");
+		}
+		deep->close();
+		flat->close();
+	}
+	EXPECT_EQ(total.load(), 200);
+}
@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+
+#include <charconv>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "CoroParseScan.hpp"
+#include "CoroParseStream.hpp"
+
+namespace
+{
+	using namespace coroparse;
+	namespace pegtl = tao::pegtl;
+
+	struct Value : pegtl::plus< pegtl::digit > { };
+	struct Record : pegtl::seq< pegtl::plus< pegtl::alpha >, pegtl::one< '=' >, Value, pegtl::one< '\n' > > { };
+	struct KeyedRecord : pegtl::seq< TAO_PEGTL_STRING("key"), pegtl::one< '=' >, Value, pegtl::one< '\n' > > { };
+	struct ScannedValue : plus_class< pegtl::digit > { };
+	struct ScannedRecord : pegtl::seq< plus_class< pegtl::alpha >, pegtl::one< '=' >, ScannedValue, pegtl::one< '\n' > > { };
+	template < class Rule > struct RecordAction : pegtl::nothing< Rule > { };
+	template < > struct RecordAction< Value > : PushToken { };
+	template < > struct RecordAction< ScannedValue > : PushToken { };
+
+	Degenerator<long, const std::string_view> sum_values()
+	{
+		long sum = 0;
+		while (auto tk = co_await NextToken)
+		{
+			long v = 0;
+			std::from_chars(tk->data(), tk->data() + tk->size(), v);
+			sum += v;
+		}
+		co_return sum;
+	}
+
+	// Hands out `text` in pieces of at most `piece` bytes, like a socket would.
+	struct StringReader
+	{
+		const std::string* text;
+		std::size_t piece;
+		std::size_t offset = 0;
+		std::size_t* reads;
+
+		std::size_t operator()(char* buffer, std::size_t length)
+		{
+			const std::size_t n = std::min({ length, piece, text->size() - offset });
+			text->copy(buffer, n, offset);
+			offset += n;
+			++*reads;
+			return n;
+		}
+	};
+
+	std::string records(int count, long& sum)
+	{
+		std::string text;
+		sum = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			text += "key=" + std::to_string(i) + "\n";
+			sum += i;
+		}
+		return text;
+	}
+}
+
+TEST(ParseStream, DocumentLargerThanTheBuffer)
+{
+	long expected = 0;
+	const std::string text = records(20000, expected);
+	std::size_t reads = 0;
+	auto d = sum_values();
+	ASSERT_TRUE((parse_stream< Record, RecordAction, 64 >(StringReader { &text, 64, 0, &reads }, d, 256)));
+	EXPECT_EQ(d.result(), expected);
+	EXPECT_GT(reads, text.size() / 64);
+}
+
+TEST(ParseStream, ClassRunsInASmallBuffer)
+{
+	long expected = 0;
+	const std::string text = records(20000, expected);
+	std::size_t reads = 0;
+	auto d = sum_values();
+	ASSERT_TRUE((parse_stream< ScannedRecord, RecordAction, 64 >(StringReader { &text, 64, 0, &reads }, d, 1024)));
+	EXPECT_EQ(d.result(), expected);
+
+	const std::string few = records(300, expected);
+	auto bytes = sum_values();
+	auto parse = incremental_parse< StreamOf< ScannedRecord >, RecordAction >(bytes, 64);
+	for (char c : few) ASSERT_EQ(parse.feed(std::string_view(&c, 1)), ParseStatus::NeedMoreInput);
+	EXPECT_EQ(parse.finish(), ParseStatus::Success);
+	EXPECT_EQ(bytes.result(), expected);
+}
+
+TEST(ParseStream, FileReader)
+{
+	long expected = 0;
+	const std::string text = records(5000, expected);
+	std::FILE* file = std::tmpfile();
+	ASSERT_NE(file, nullptr);
+	std::fwrite(text.data(), 1, text.size(), file);
+	std::rewind(file);
+
+	auto d = sum_values();
+	EXPECT_TRUE((parse_stream< Record, RecordAction >(FileReader { file }, d, 1024)));
+	EXPECT_EQ(d.result(), expected);
+	std::fclose(file);
+}
+
+TEST(ParseStream, RejectsMalformedItem)
+{
+	const std::string text = "a=1\nb=2\nc=\n";
+	std::size_t reads = 0;
+	auto d = sum_values();
+	EXPECT_FALSE((parse_stream< Record, RecordAction >(StringReader { &text, 5, 0, &reads }, d, 64)));
+	EXPECT_EQ(d.result(), 3);
+}
+
+#if defined(COROPARSE_HAS_UCONTEXT)
+TEST(IncrementalParse, ByteByByte)
+{
+	long expected = 0;
+	const std::string text = records(500, expected);
+	auto d = sum_values();
+	auto parse = incremental_parse< StreamOf< KeyedRecord >, RecordAction >(d, 64);
+	for (char c : text) ASSERT_EQ(parse.feed(std::string_view(&c, 1)), ParseStatus::NeedMoreInput);
+	EXPECT_EQ(parse.finish(), ParseStatus::Success);
+	EXPECT_EQ(d.result(), expected);
+}
+
+TEST(IncrementalParse, ManyInterleavedParses)
+{
+	constexpr int parsers = 200;
+	long expected = 0;
+	const std::string text = records(300, expected);
+
+	struct Session
+	{
+		Degenerator<long, const std::string_view> d = sum_values();
+		IncrementalParse< StreamOf< KeyedRecord >, RecordAction, Degenerator<long, const std::string_view> > parse { d, 128, 64 * 1024 };
+		std::size_t offset = 0;
+	};
+	std::vector< std::unique_ptr< Session > > sessions;
+	for (int i = 0; i < parsers; ++i) sessions.push_back(std::make_unique< Session >());
+
+	// Every session receives the same stream, cut into differently sized pieces.
+	bool pending = true;
+	while (pending)
+	{
+		pending = false;
+		for (int i = 0; i < parsers; ++i)
+		{
+			Session& s = *sessions[i];
+			if (s.offset == text.size()) continue;
+			const std::size_t n = std::min< std::size_t >(1 + i % 17, text.size() - s.offset);
+			ASSERT_EQ(s.parse.feed(std::string_view(text).substr(s.offset, n)), ParseStatus::NeedMoreInput);
+			s.offset += n;
+			pending = true;
+		}
+	}
+	for (auto& s : sessions)
+	{
+		EXPECT_EQ(s->parse.finish(), ParseStatus::Success);
+		EXPECT_EQ(s->d.result(), expected);
+	}
+}
+
+TEST(IncrementalParse, FailureAndAbandonedParse)
+{
+	auto bad = sum_values();
+	auto failing = incremental_parse< StreamOf< KeyedRecord >, RecordAction >(bad);
+	EXPECT_EQ(failing.feed("key=1\nkey"), ParseStatus::NeedMoreInput);
+	EXPECT_EQ(failing.feed("=x\n"), ParseStatus::Failure);
+	EXPECT_EQ(bad.result(), 1);
+
+	auto d = sum_values();
+	{
+		auto abandoned = incremental_parse< StreamOf< KeyedRecord >, RecordAction >(d);
+		EXPECT_EQ(abandoned.feed("key=4\nkey="), ParseStatus::NeedMoreInput);
+	}
+	EXPECT_EQ(d.result(), 4);
+}
+#endif
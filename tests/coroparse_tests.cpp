@@ -0,0 +1,324 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "CoroParse.hpp"
+
+namespace
+{
+	using namespace coroparse;
+	namespace pegtl = tao::pegtl;
+
+	ParserProc<int> collect(int depth, std::string& log)
+	{
+		if (depth == 0)
+		{
+			auto tk = co_await NextToken;
+			log += tk.value_or("-");
+			co_return 1;
+		}
+		int r = co_await collect(depth - 1, log);
+		auto tk = co_await NextToken;
+		log += tk.value_or("-");
+		co_return r + 1;
+	}
+
+	ParserProc<int> leaf(std::string& log)
+	{
+		auto tk = co_await NextToken;
+		log += tk.value_or("-");
+		co_return 10;
+	}
+	// Takes a token itself before awaiting a child, so the child starts from a frame resumed
+	// by `push_token` rather than by the driver walking the stack.
+	ParserProc<int> middle(std::string& log)
+	{
+		auto tk = co_await NextToken;
+		log += tk.value_or("-");
+		co_return co_await leaf(log) + 100;
+	}
+	ParserProc<int> outer(std::string& log)
+	{
+		int r = co_await middle(log);
+		auto tk = co_await NextToken;
+		log += tk.value_or("-");
+		co_return r + 1;
+	}
+
+	ParserProc<int> no_tokens(int depth)
+	{
+		if (depth == 0) co_return 0;
+		co_return co_await no_tokens(depth - 1) + 1;
+	}
+
+	Degenerator<int, const int> sum_tree(int depth)
+	{
+		if (depth == 0)
+		{
+			auto tk = co_await NextToken;
+			co_return tk ? *tk : 0;
+		}
+		int r = co_await sum_tree(depth - 1);
+		r += co_await sum_tree(depth - 1);
+		auto tk = co_await NextToken;
+		co_return r + (tk ? *tk : 0);
+	}
+
+	Degenerator<int, const int> sum_batches(std::size_t batch)
+	{
+		int sum = 0;
+		while (true)
+		{
+			auto tokens = co_await NextTokens{ batch };
+			if (tokens.empty()) break;
+			for (int tk : tokens) sum += tk;
+		}
+		co_return sum;
+	}
+
+	Degenerator<int, const int> count_down(int depth)
+	{
+		if (depth == 0) co_return 0;
+		co_return co_await count_down(depth - 1) + 1;
+	}
+
+	Degenerator<int, const int> fail_at(int depth)
+	{
+		if (depth == 0) throw std::runtime_error("leaf failed");
+		co_return co_await fail_at(depth - 1);
+	}
+
+	Degenerator<int, const std::string_view> words(const char* first, const char* last)
+	{
+		int n = 0;
+		while (auto tk = co_await NextToken)
+		{
+			// Tokens point into the input, they are not copies.
+			if (tk->data() < first || tk->data() + tk->size() > last) co_return -1;
+			++n;
+		}
+		co_return n;
+	}
+
+	// Neither default constructible nor copyable.
+	struct Tree
+	{
+		explicit Tree(int n) : nodes(static_cast< std::size_t >(n)) { }
+		Tree(Tree&&) = default;
+		Tree(const Tree&) = delete;
+		std::vector< int > nodes;
+	};
+
+	Degenerator<Tree, const int> build_tree(int depth)
+	{
+		if (depth == 0) co_return Tree { 1 };
+		Tree child = co_await build_tree(depth - 1);
+		child.nodes.push_back(depth);
+		co_return std::move(child);
+	}
+
+	ParserProc<std::unique_ptr< int >> boxed(int depth)
+	{
+		if (depth == 0) co_return std::make_unique< int >(0);
+		auto inner = co_await boxed(depth - 1);
+		++*inner;
+		co_return inner;
+	}
+
+	// Rejects the input when the token at the bottom of `depth` frames is negative.
+	Degenerator<int, const int> reject_negative(int depth, int& resumed_parents)
+	{
+		if (depth == 0)
+		{
+			auto tk = co_await NextToken;
+			if (!tk || *tk < 0) co_return ParseError { "negative" };
+			co_return *tk;
+		}
+		int r = co_await reject_negative(depth - 1, resumed_parents);
+		++resumed_parents;
+		co_return r;
+	}
+
+	ParserProc<int> reject_empty(int depth)
+	{
+		if (depth == 0)
+		{
+			auto tk = co_await NextToken;
+			if (!tk || tk->empty()) co_return ParseError { "empty" };
+			co_return static_cast< int >(tk->size());
+		}
+		co_return co_await reject_empty(depth - 1);
+	}
+
+	ParserProc<int> reject_eagerly(int depth)
+	{
+		if (depth == 0) co_return ParseError { "eager" };
+		co_return co_await reject_eagerly(depth - 1);
+	}
+
+	struct Word : pegtl::plus< pegtl::alpha > { };
+	struct WordList : pegtl::list< Word, pegtl::one< ',' > > { };
+	template < class Rule > struct WordAction : pegtl::nothing< Rule > { };
+	template < > struct WordAction< Word > : PushToken { };
+}
+
+TEST(ParserProc, DeliversTokensThroughNestedFrames)
+{
+	std::string log;
+	auto p = collect(4, log);
+	for (const char* tk : { "a", "b", "c" }) p.push_token(tk);
+	EXPECT_EQ(p.result(), 5);
+	EXPECT_EQ(log, "abc--");
+}
+
+TEST(ParserProc, ChildAwaitedAfterATokenInAMiddleFrame)
+{
+	std::string log;
+	auto p = outer(log);
+	for (const char* tk : { "a", "b", "c" }) p.push_token(tk);
+	EXPECT_EQ(p.result(), 111);
+	EXPECT_EQ(log, "abc");
+}
+
+TEST(ParserProc, ChildrenFinishingEagerly)
+{
+	auto p = no_tokens(16);
+	EXPECT_EQ(p.result(), 16);
+}
+
+TEST(Degenerator, NestedResults)
+{
+	auto d = sum_tree(3);
+	const int one = 1;
+	for (int i = 0; i < 15; ++i) d.push_value(one);
+	EXPECT_EQ(d.result(), 15);
+}
+
+TEST(Degenerator, DeepRecursion)
+{
+	auto d = count_down(1000);
+	EXPECT_EQ(d.result(), 1000);
+}
+
+TEST(Degenerator, ExceptionsPropagateToTheBase)
+{
+	auto d = fail_at(3);
+	EXPECT_THROW(d.result(), std::runtime_error);
+}
+
+TEST(Degenerator, BatchedPush)
+{
+	std::vector< int > values(100);
+	for (int i = 0; i < 100; ++i) values[i] = i;
+	auto d = sum_batches(7);
+	d.push_values(std::span< const int >(values));
+	EXPECT_EQ(d.result(), 4950);
+}
+
+TEST(Degenerator, MovesResultsOutOfChildren)
+{
+	auto d = build_tree(4);
+	Tree t = d.result();
+	EXPECT_EQ(t.nodes.size(), 5u);
+}
+
+TEST(ParserProc, MovesResultsOutOfChildren)
+{
+	auto p = boxed(3);
+	EXPECT_EQ(*p.result(), 3);
+}
+
+TEST(Degenerator, ParseErrorSkipsToTheBase)
+{
+	int resumed_parents = 0;
+	auto d = reject_negative(8, resumed_parents);
+	const int bad = -1;
+	d.push_value(bad);
+	EXPECT_TRUE(d.failed());
+	d.push_value(bad); // Dropped.
+	auto r = d.try_result();
+	ASSERT_FALSE(r.has_value());
+	EXPECT_EQ(r.error().message, "negative");
+	EXPECT_EQ(resumed_parents, 0);
+}
+
+TEST(Degenerator, ParseErrorNotRaisedOnValidInput)
+{
+	int resumed_parents = 0;
+	auto d = reject_negative(8, resumed_parents);
+	const int good = 7;
+	d.push_value(good);
+	auto r = d.try_result();
+	ASSERT_TRUE(r.has_value());
+	EXPECT_EQ(*r, 7);
+	EXPECT_EQ(resumed_parents, 8);
+}
+
+TEST(Degenerator, ResultOfRejectedParseThrows)
+{
+	int resumed_parents = 0;
+	auto d = reject_negative(2, resumed_parents);
+	EXPECT_THROW(d.result(), std::runtime_error);
+}
+
+TEST(ParserProc, ParseErrorSkipsToTheBase)
+{
+	auto p = reject_empty(5);
+	p.push_token("");
+	EXPECT_TRUE(p.failed());
+	p.push_token("dropped");
+	auto r = p.try_result();
+	ASSERT_FALSE(r.has_value());
+	EXPECT_EQ(r.error().message, "empty");
+
+	auto ok = reject_empty(5);
+	ok.push_token("four");
+	EXPECT_EQ(*ok.try_result(), 4);
+}
+
+TEST(ParserProc, ParseErrorWhileStarting)
+{
+	auto p = reject_eagerly(4);
+	EXPECT_EQ(p.try_result().error().message, "eager");
+}
+
+TEST(FrameArena, ReusesChunksAcrossParses)
+{
+	FrameArena arena;
+	FrameArena::Scope scope { &arena };
+	for (int round = 0; round < 3; ++round)
+	{
+		auto d = sum_tree(5);
+		const int one = 1;
+		for (int i = 0; i < 63; ++i) d.push_value(one);
+		EXPECT_EQ(d.result(), 63);
+
+		std::string log;
+		auto p = collect(5, log);
+		p.push_token("x");
+		EXPECT_EQ(p.result(), 6);
+	}
+	EXPECT_EQ(arena.chunk_count(), 1u);
+}
+
+TEST(FrameArena, OutOfOrderRelease)
+{
+	FrameArena arena(256);
+	FrameArena::Scope scope { &arena };
+	std::optional< Degenerator<int, const int> > first { sum_tree(2) };
+	std::optional< Degenerator<int, const int> > second { sum_tree(2) };
+	first.reset(); // Released below a live frame, reclaimed once `second` is gone.
+	EXPECT_EQ(second->result(), 0);
+}
+
+TEST(PushToken, ViewsIntoTheInput)
+{
+	const std::string text = "alpha,beta,gamma";
+	pegtl::memory_input in(text, "");
+	auto d = words(text.data(), text.data() + text.size());
+	ASSERT_TRUE((pegtl::parse< WordList, WordAction >(in, d)));
+	EXPECT_EQ(d.result(), 3);
+}